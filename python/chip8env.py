@@ -0,0 +1,99 @@
+"""Thin ctypes binding over bin/libchip8env.so.
+
+Observations are exposed as a memoryview straight into the shared memory
+block, wrap it with numpy.frombuffer() to get a tensor without copying.
+"""
+
+import ctypes
+import os
+
+OBS_PACKED = 0
+OBS_BYTES = 1
+
+
+class _Header(ctypes.Structure):
+    _fields_ = [
+        ("magic", ctypes.c_uint32),
+        ("version", ctypes.c_uint32),
+        ("num_envs", ctypes.c_uint32),
+        ("format", ctypes.c_uint32),
+        ("width", ctypes.c_uint32),
+        ("height", ctypes.c_uint32),
+        ("obs_offset", ctypes.c_uint32),
+        ("obs_stride", ctypes.c_uint32),
+        ("done_offset", ctypes.c_uint32),
+        ("_reserved", ctypes.c_uint32),
+        ("steps", ctypes.c_uint64),
+    ]
+
+
+def _load(path=None):
+    if path is None:
+        here = os.path.dirname(os.path.abspath(__file__))
+        path = os.path.join(here, "..", "bin", "libchip8env.so")
+    lib = ctypes.CDLL(path)
+    lib.chip8_vecenv_create.restype = ctypes.c_void_p
+    lib.chip8_vecenv_create.argtypes = [
+        ctypes.c_char_p, ctypes.c_uint32, ctypes.c_int, ctypes.c_char_p]
+    lib.chip8_vecenv_destroy.argtypes = [ctypes.c_void_p]
+    lib.chip8_vecenv_shm.restype = ctypes.c_void_p
+    lib.chip8_vecenv_shm.argtypes = [ctypes.c_void_p]
+    lib.chip8_vecenv_shm_size.restype = ctypes.c_size_t
+    lib.chip8_vecenv_shm_size.argtypes = [ctypes.c_void_p]
+    lib.chip8_vecenv_step.argtypes = [
+        ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint16), ctypes.c_uint32]
+    lib.chip8_vecenv_reset.argtypes = [
+        ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint8), ctypes.c_void_p]
+    lib.chip8_vecenv_snapshot.restype = ctypes.c_void_p
+    lib.chip8_vecenv_snapshot.argtypes = [ctypes.c_void_p, ctypes.c_uint32]
+    lib.chip8_snapshot_free.argtypes = [ctypes.c_void_p]
+    return lib
+
+
+class VecEnv:
+    def __init__(self, rom, num_envs, obs_format=OBS_BYTES, shm_name=None,
+                 lib_path=None):
+        self._lib = _load(lib_path)
+        self._env = self._lib.chip8_vecenv_create(
+            rom.encode(), num_envs, obs_format,
+            shm_name.encode() if shm_name else None)
+        if not self._env:
+            raise RuntimeError(f"couldn't create vecenv for {rom}")
+
+        self.num_envs = num_envs
+        shm = self._lib.chip8_vecenv_shm(self._env)
+        size = self._lib.chip8_vecenv_shm_size(self._env)
+        raw = (ctypes.c_uint8 * size).from_address(shm)
+        raw = self._raw = memoryview(raw).cast("B")
+        self.header = _Header.from_address(shm)
+        obs_end = self.header.obs_offset + self.header.obs_stride * num_envs
+        self.observations = raw[self.header.obs_offset:obs_end]
+        done_start = self.header.done_offset
+        self.done = raw[done_start:done_start + num_envs]
+
+    def step(self, keys=None, frames=1):
+        masks = None
+        if keys is not None:
+            masks = (ctypes.c_uint16 * self.num_envs)(*keys)
+        self._lib.chip8_vecenv_step(self._env, masks, frames)
+
+    def reset(self, mask=None, snapshot=None):
+        flags = None
+        if mask is not None:
+            flags = (ctypes.c_uint8 * self.num_envs)(*mask)
+        self._lib.chip8_vecenv_reset(self._env, flags, snapshot)
+
+    def snapshot(self, index):
+        return ctypes.c_void_p(self._lib.chip8_vecenv_snapshot(self._env,
+                                                               index))
+
+    def free_snapshot(self, snapshot):
+        self._lib.chip8_snapshot_free(snapshot)
+
+    def close(self):
+        if self._env:
+            self.observations.release()
+            self.done.release()
+            self._raw.release()
+            self._lib.chip8_vecenv_destroy(self._env)
+            self._env = None
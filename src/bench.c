@@ -0,0 +1,111 @@
+#define _GNU_SOURCE
+
+#include <raylib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "../utils/types.h"
+
+#define BENCH_SEED    0xC8
+#define BENCH_REPEATS 5  // Best run is kept to filter out scheduler noise
+
+typedef struct {
+        double  seconds;
+        chip8_t chip8;
+} bench_run_t;
+
+double monotonic_seconds(void) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec + (now.tv_nsec / 1e9);
+}
+
+// Runs a rom headless with no keys pressed, every run sees the same rand()
+// sequence so final states can be compared between fused and plain runs.
+bool bench_rom(bench_run_t* run,
+               const char   rom_name[],
+               const u32    frames,
+               const bool   fused) {
+        run->seconds = 0;
+        for (u32 repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+                chip8_image_t* image = load_chip8_image(rom_name);
+                if (!image) {
+                        return false;
+                }
+                release_chip8(&run->chip8);
+                memset(&run->chip8, 0, sizeof(run->chip8));
+                init_chip8_from_image(&run->chip8, image);
+                release_chip8_image(image);
+                if (fused) {
+                        enable_fusion(&run->chip8);
+                }
+
+                srand(BENCH_SEED);
+                const double start = monotonic_seconds();
+                for (u32 frame = 0; frame < frames; frame++) {
+                        emulate_frame(&run->chip8);
+                }
+                const double seconds = monotonic_seconds() - start;
+                if (repeat == 0 || seconds < run->seconds) {
+                        run->seconds = seconds;
+                }
+        }
+        return true;
+}
+
+bool same_state(const chip8_t* a, const chip8_t* b) {
+        for (u32 addr = 0; addr < RAM_SIZE; addr++) {
+                if (read_ram(a, addr) != read_ram(b, addr)) {
+                        return false;
+                }
+        }
+        return a->PC == b->PC && a->I == b->I &&
+               a->sp == b->sp &&
+               memcmp(a->V, b->V, sizeof(a->V)) == 0 &&
+               memcmp(a->display, b->display, sizeof(a->display)) == 0;
+}
+
+int main(int argc, char* argv[]) {
+        if (argc < 3) {
+                fprintf(stderr,
+                        "Usage: %s <frames> <rom_file> [rom_file...]\n",
+                        argv[0]);
+                exit(EXIT_FAILURE);
+        }
+
+        const u32 frames = (u32)strtoul(argv[1], NULL, 10);
+        const double instructions =
+            (double)frames * INSTRUCTIONS_PER_FRAME / 1e6;
+        bool ok = true;
+
+        static bench_run_t plain;
+        static bench_run_t fused;
+        for (int i = 2; i < argc; i++) {
+                if (!bench_rom(&plain, argv[i], frames, false) ||
+                    !bench_rom(&fused, argv[i], frames, true)) {
+                        exit(EXIT_FAILURE);
+                }
+
+                printf("%s\n", argv[i]);
+                printf("  plain %7.1f Minst/s  fused %7.1f Minst/s  x%.2f\n",
+                       instructions / plain.seconds,
+                       instructions / fused.seconds,
+                       plain.seconds / fused.seconds);
+                for (u32 id = FUSION_NONE + 1; id < FUSION_TRAP; id++) {
+                        printf("  %-16s %llu\n",
+                               fusion_lookup[id],
+                               (unsigned long long)fused.chip8.fusion_hits[id]);
+                }
+
+                if (!same_state(&plain.chip8, &fused.chip8)) {
+                        printf("  MISMATCH: fused run diverged\n");
+                        ok = false;
+                }
+        }
+
+        exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
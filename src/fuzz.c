@@ -0,0 +1,184 @@
+#define _GNU_SOURCE
+
+#include <raylib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "../utils/types.h"
+
+// In-process fuzzing harness: every input is a rom, run headless for a bounded
+// number of frames on one preallocated image and machine. Built with
+// -DCHIP8_LIBFUZZER it only exports LLVMFuzzerTestOneInput, otherwise main()
+// runs the files given (or stdin) so it also works under afl-fuzz. Inputs run
+// through the plain interpreter like the frontends do, -DFUZZ_FUSED runs them
+// through fused dispatch instead.
+
+// Frames per input, -DFUZZ_FRAMES=N trades execs/s for depth.
+#ifndef FUZZ_FRAMES
+#        define FUZZ_FRAMES 2
+#endif
+#define FUZZ_SEED    0xC8
+#define FUZZ_ROMNAME "fuzz-input"
+
+static chip8_image_t image = {.refs = 1, .rom_name = FUZZ_ROMNAME};
+static chip8_t       chip8;
+static u8            loaded_ram[RAM_SIZE];
+static u8            loaded_fusion[RAM_SIZE];
+static u32           loaded_end;  // Past it the image is zeroed
+static u64           last_display[CHIP_HEIGHT];
+static char          rand_state[8];  // Smallest state, reseeding it is a store
+
+static void check(const bool ok, const char* invariant) {
+        if (!ok) {
+                fprintf(stderr,
+                        "Invariant broken: %s (PC=0x%04X I=0x%04X sp=%u)\n",
+                        invariant,
+                        chip8.PC,
+                        chip8.I,
+                        chip8.sp);
+                abort();
+        }
+}
+
+// Rows a frame changed must be marked, the server only streams those.
+static void check_dirty_rows(void) {
+        for (u32 row = 0; row < CHIP_HEIGHT; row++) {
+                check(chip8.display[row] == last_display[row] ||
+                          (chip8.dirty_rows & (1u << row)),
+                      "changed display row not marked dirty");
+        }
+}
+
+// Fused entries on written pages must still match the code under them.
+static void check_fusions(const u8 page) {
+        const u8* ram    = chip8.pages[page];
+        const u8* fusion = chip8.fusion_pages[page];
+        for (u32 offset = 0; offset + MAX_FUSION_BYTES <= PAGE_SIZE; offset++) {
+                check(fusion[offset] == FUSION_NONE ||
+                          fusion[offset] == match_fusion_bytes(&ram[offset]),
+                      "fusion left over rewritten code");
+        }
+}
+
+// Pages not yet written must still point into the shared image.
+static void check_pages(void) {
+        for (u8 page = 0; page < PAGE_COUNT; page++) {
+                if (chip8.private_pages & (1u << page)) {
+                        if (chip8.fused) {
+                                check_fusions(page);
+                        }
+                        continue;
+                }
+                check(chip8.pages[page] == &image.ram[page * PAGE_SIZE],
+                      "shared ram page moved");
+                check(chip8.fusion_pages[page] ==
+                          &image.fusion[page * PAGE_SIZE],
+                      "shared fusion page moved");
+        }
+        check(chip8.writable_pages == chip8.private_pages,
+              "writable pages differ from private pages");
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+        if (!load_chip8_rom(&image, data, size)) {
+                return 0;  // Doesn't fit in ram, the loader rejects it too
+        }
+        memset(&chip8, 0, sizeof(chip8));
+        init_chip8_from_image(&chip8, &image);
+#ifdef FUZZ_FUSED
+        enable_fusion(&chip8);
+#endif
+        loaded_end = ENTRY_POINT + size;
+        memcpy(loaded_ram, image.ram, loaded_end);
+        memcpy(loaded_fusion, image.fusion, loaded_end);
+        initstate(FUZZ_SEED, rand_state, sizeof(rand_state));
+
+        for (u32 frame = 0; frame < FUZZ_FRAMES && chip8.state != QUIT;
+             frame++) {
+                // Walk the keypad so FX0A and EX9E/EXA1 take both branches.
+                memset(chip8.keypad, 0, sizeof(chip8.keypad));
+                chip8.keypad[frame & KEYPAD_MASK] = frame & 0x10;
+
+                memcpy(last_display, chip8.display, sizeof(last_display));
+                chip8.dirty_rows = 0;
+                emulate_frame(&chip8);
+                check_dirty_rows();
+        }
+
+        check_pages();
+        check(memcmp(loaded_ram, image.ram, loaded_end) == 0,
+              "write reached the shared image");
+        check(memcmp(loaded_fusion, image.fusion, loaded_end) == 0,
+              "fusion table of the shared image changed");
+        check(image.refs == 2, "image reference leaked");
+
+        release_chip8(&chip8);
+        return 0;
+}
+
+#ifndef CHIP8_LIBFUZZER
+
+static size_t read_input(FILE* file, u8 data[], const size_t max_size) {
+        size_t size = 0;
+        size_t read = 0;
+        while (size < max_size &&
+               (read = fread(&data[size], 1, max_size - size, file)) > 0) {
+                size += read;
+        }
+        return size;
+}
+
+static double monotonic_seconds(void) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec + (now.tv_nsec / 1e9);
+}
+
+// One byte past the largest rom so oversized inputs are still rejected.
+static u8 input[RAM_SIZE - ENTRY_POINT + 1];
+
+int main(int argc, char* argv[]) {
+        SetTraceLogLevel(LOG_NONE);
+
+        u32 repeats = 1;
+        int first   = 1;
+        if (argc > 2 && strcmp(argv[1], "-r") == 0) {
+                repeats = (u32)strtoul(argv[2], NULL, 10);
+                first   = 3;
+        }
+
+        if (first == argc) {
+                const size_t size = read_input(stdin, input, sizeof(input));
+                LLVMFuzzerTestOneInput(input, size);
+                exit(EXIT_SUCCESS);
+        }
+
+        for (int i = first; i < argc; i++) {
+                FILE* file = fopen(argv[i], "rb");
+                if (!file) {
+                        fprintf(stderr, "Couldn't open %s\n", argv[i]);
+                        exit(EXIT_FAILURE);
+                }
+                const size_t size = read_input(file, input, sizeof(input));
+                fclose(file);
+
+                const double start = monotonic_seconds();
+                for (u32 run = 0; run < repeats; run++) {
+                        LLVMFuzzerTestOneInput(input, size);
+                }
+                if (repeats > 1) {
+                        fprintf(stderr,
+                                "%s: %.0f execs/s\n",
+                                argv[i],
+                                repeats / (monotonic_seconds() - start));
+                }
+        }
+        exit(EXIT_SUCCESS);
+}
+
+#endif
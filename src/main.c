@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include <raylib.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -6,11 +8,18 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "../utils/debugger.h"
+#include "../utils/frametime.h"
 #include "../utils/types.h"
 
 #define TARGET_FPS 60
 #define SECOND     1000.0f
 
+// Recompiled roms include this file with their own block runner.
+#ifndef CHIP8_RUN
+#        define CHIP8_RUN run_instructions
+#endif
+
 bool init_raylib(config_t config) {
         InitWindow(config.window_width * config.scale_factor,
                    config.window_height * config.scale_factor,
@@ -29,75 +38,19 @@ bool set_config_from_args(config_t* config, const int argc, char** argv) {
             .bg_color = BLACK,
         };
 
-        for (int i = 1; i < argc; ++i) {
-                (void)argv[i];
-        }
-
-        return true;
-}
-
-bool init_chip8(chip8_t* chip8, const char rom_name[]) {
-        const u32 entry_point = 0x200;
-        const u8  font[]      = {
-            0xF0, 0x90, 0x90, 0x90, 0xF0,  // 0
-            0x20, 0x60, 0x20, 0x20, 0x70,  // 1
-            0xF0, 0x10, 0xF0, 0x80, 0xF0,  // 2
-            0xF0, 0x10, 0xF0, 0x10, 0xF0,  // 3
-            0x90, 0x90, 0xF0, 0x10, 0x10,  // 4
-            0xF0, 0x80, 0xF0, 0x10, 0xF0,  // 5
-            0xF0, 0x80, 0xF0, 0x90, 0xF0,  // 6
-            0xF0, 0x10, 0x20, 0x40, 0x40,  // 7
-            0xF0, 0x90, 0xF0, 0x90, 0xF0,  // 8
-            0xF0, 0x90, 0xF0, 0x10, 0xF0,  // 9
-            0xF0, 0x90, 0xF0, 0x90, 0x90,  // A
-            0xE0, 0x90, 0xE0, 0x90, 0xE0,  // B
-            0xF0, 0x80, 0x80, 0x80, 0xF0,  // C
-            0xE0, 0x90, 0x90, 0x90, 0xE0,  // D
-            0xF0, 0x80, 0xF0, 0x80, 0xF0,  // E
-            0xF0, 0x80, 0xF0, 0x80, 0x80   // F
-        };
-
-        memcpy(&chip8->ram[0], font, sizeof(font));
-
-        FILE* rom = fopen(rom_name, "rb");
-        if (!rom) {
-                TraceLog(LOG_ERROR,
-                         "Rom file %s is invalid or does not exist...",
-                         rom_name);
-                return false;
-        }
-        if (fseek(rom, 0, SEEK_END) != 0) {
-                TraceLog(LOG_ERROR, "Couldn't move cursor to end of file\n");
-                return false;
-        };
-
-        const size_t rom_size = ftell(rom);
-        const size_t max_size = sizeof(chip8->ram) - entry_point;
-        if (fseek(rom, 0, SEEK_SET) != 0) {
-                TraceLog(LOG_ERROR,
-                         "Couldn't move cursor to beginning of file\n");
-                return false;
-        }
-
-        if (rom_size > max_size) {
-                TraceLog(LOG_ERROR,
-                         "Rom file %s is too big for this chip8, max size: %zu",
-                         rom_name,
-                         max_size);
-                return false;
-        }
-
-        if (fread(&chip8->ram[entry_point], rom_size, 1, rom) != 1) {
-                TraceLog(
-                    LOG_ERROR, "Couldn't read rom: %s, into ram\n", rom_name);
-                return false;
+        for (int i = 2; i < argc; ++i) {
+                if (strcmp(argv[i], "--debug") == 0) {
+                        config->debug = true;
+                } else if (strcmp(argv[i], "--fuse") == 0) {
+                        config->fuse = true;
+                } else if (strcmp(argv[i], "--frame-stats") == 0 &&
+                           i + 1 < argc) {
+                        config->stats_path = argv[++i];
+                } else {
+                        fprintf(stderr, "Unknown option: %s\n", argv[i]);
+                        return false;
+                }
         }
-        fclose(rom);
-
-        chip8->state     = RUNNING;
-        chip8->stack_ptr = &chip8->stack[0];
-        chip8->PC        = entry_point;
-        chip8->rom_name  = rom_name;
 
         return true;
 }
@@ -110,23 +63,30 @@ void clear_screen(const config_t config) {
         ClearBackground(*(Color*)&config.bg_color);
 }
 
-void update_screen(const config_t config, const chip8_t chip8) {
+// Frame stats are drawn on top when timer isn't NULL.
+void update_screen(const config_t       config,
+                   const chip8_t        chip8,
+                   const frame_timer_t* timer) {
         BeginDrawing();
         clear_screen(config);
 
         Color fg_ray_color = *(Color*)&config.fg_color;
 
-        for (u32 row = 0; row < sizeof chip8.display; row++) {
-                if (chip8.display[row]) {
-                        DrawRectangle((int)(row % config.window_width) *
-                                          config.scale_factor,
-                                      (int)(row / config.window_width) *
-                                          config.scale_factor,
-                                      config.scale_factor,
-                                      config.scale_factor,
-                                      fg_ray_color);
+        for (u32 row = 0; row < CHIP_HEIGHT; row++) {
+                const u64 line = chip8.display[row];
+                for (u32 col = 0; line && col < CHIP_WIDTH; col++) {
+                        if ((line >> (CHIP_WIDTH - 1 - col)) & 0x1) {
+                                DrawRectangle((int)col * config.scale_factor,
+                                              (int)row * config.scale_factor,
+                                              config.scale_factor,
+                                              config.scale_factor,
+                                              fg_ray_color);
+                        }
                 }
         }
+        if (timer) {
+                draw_frame_timer(timer, config.scale_factor, WHITE);
+        }
         EndDrawing();
 }
 
@@ -144,6 +104,10 @@ void handle_input_raylib(chip8_t* chip8) {
                 chip8->state = chip8->state == RUNNING ? PAUSED : RUNNING;
                 return;
         }
+        if (chip8->debugger && IsKeyPressed(KEY_F1)) {
+                debugger_interrupt(chip8);
+                return;
+        }
 
         // Zera estado anterior
         memset(chip8->keypad, 0, sizeof(chip8->keypad));
@@ -170,37 +134,12 @@ void handle_input_raylib(chip8_t* chip8) {
         chip8->keypad[0xF] = IsKeyDown(KEY_V);
 }
 
-void emulate_instruction(chip8_t* chip8) {
-        const u8 byte      = 8;
-        const u8 mask      = 0xF;
-        const u8 high      = chip8->ram[chip8->PC];
-        const u8 low       = chip8->ram[chip8->PC + 1];
-        chip8->inst.opcode = (high << byte) | low;
-        chip8->PC += 2;
-
-        DEBUG_LOG(
-            "PC: 0x%03X | Opcode: 0x%04X | ", chip8->PC, chip8->inst.opcode);
-
-        u8 op_high_nibble = (chip8->inst.opcode >> (byte + 4)) & mask;
-        instruction_handler_t handler = instruction_table[op_high_nibble];
-        if (!handler) {
-                DEBUG_LOG("\n");
-                TraceLog(LOG_ERROR,
-                         "Unimplemented instruction: 0x%04X",
-                         chip8->inst.opcode);
-
-#ifndef DEBUG
-                chip8->state = QUIT;
-#endif
-
-                return;
-        }
-        handler(chip8);
-}
-
 int main(int argc, char* argv[]) {
         if (argc < 2) {
-                fprintf(stderr, "Usage: %s <rom_file>\n", argv[0]);
+                fprintf(stderr,
+                        "Usage: %s <rom_file> [--debug] [--fuse] "
+                        "[--frame-stats out.json]\n",
+                        argv[0]);
                 exit(EXIT_FAILURE);
         }
 
@@ -219,13 +158,29 @@ int main(int argc, char* argv[]) {
                 fin_cleanup();
                 exit(EXIT_FAILURE);
         }
+        if (conf.fuse) {
+                enable_fusion(&chip8);
+        }
+
+        static debugger_t dbg;
+        if (conf.debug) {
+                attach_debugger(&chip8, &dbg);
+        }
 
         clear_screen(conf);
 
+        static frame_timer_t timer;
+        init_frame_timer(&timer, TARGET_FPS);
+
         emulator_state_t curr_state = chip8.state;
         static double    last_time  = 0;
         while (chip8.state != QUIT) {
+                frame_timer_begin(&timer);
                 handle_input_raylib(&chip8);
+                if (IsKeyPressed(KEY_F3)) {
+                        timer.overlay = !timer.overlay;
+                }
+
                 if (chip8.state != curr_state) {
                         curr_state = chip8.state;
                         DEBUG_LOG("Changed State: %s\n",
@@ -233,11 +188,19 @@ int main(int argc, char* argv[]) {
                 }
 
                 if (chip8.state == PAUSED) {
+                        if (conf.debug && dbg.stopped) {
+                                debugger_prompt(&chip8);
+                        }
+                        frame_timer_skip(&timer);
                         continue;
                 }
+                frame_timer_mark(&timer, PHASE_INPUT);
 
-                for (int i = 0; i < INSTRUCTIONS_PER_FRAME; i++)
-                        emulate_instruction(&chip8);
+                CHIP8_RUN(&chip8, INSTRUCTIONS_PER_FRAME);
+                if (conf.debug) {
+                        debugger_end_frame(&chip8);
+                }
+                frame_timer_mark(&timer, PHASE_CPU);
 
                 double now = GetTime();
                 if (now - last_time >= 1.0 / 60.0) {
@@ -245,9 +208,16 @@ int main(int argc, char* argv[]) {
                         if (chip8.sound_timer > 0) chip8.sound_timer--;
                         last_time = now;
                 }
-                update_screen(conf, chip8);
+                frame_timer_mark(&timer, PHASE_TIMERS);
+
+                update_screen(conf, chip8, timer.overlay ? &timer : NULL);
+                frame_timer_mark(&timer, PHASE_RENDER);
         }
 
+        if (conf.stats_path) {
+                export_frame_timer(&timer, conf.stats_path);
+        }
+        release_chip8(&chip8);
         fin_cleanup();
         exit(EXIT_SUCCESS);
 }
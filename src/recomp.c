@@ -0,0 +1,697 @@
+#include <raylib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../utils/types.h"
+
+// How an instruction hands control to the next one.
+typedef enum {
+        FLOW_NEXT,
+        FLOW_JUMP,
+        FLOW_CALL,
+        FLOW_RETURN,
+        FLOW_SKIP,
+        FLOW_INDIRECT,  // BNNN, target only known at runtime
+        FLOW_WAIT,      // FX0A, may re-execute itself
+        FLOW_INVALID,
+} flow_t;
+
+typedef struct {
+        chip8_t chip8;  // Only the loaded image is used
+        u16     rom_end;
+        bool    reachable[RAM_SIZE];
+        bool    leader[RAM_SIZE];
+} program_t;
+
+u16 fetch(const program_t* prog, const u16 addr) {
+        return fetch_opcode(&prog->chip8, addr);
+}
+
+bool in_rom(const program_t* prog, const u32 addr) {
+        return addr >= ENTRY_POINT && addr + 1 < prog->rom_end;
+}
+
+flow_t classify(const u16 opcode) {
+        const u8 low_nibble = opcode & 0x000F;
+        const u8 low_byte   = opcode & 0x00FF;
+
+        switch (opcode >> 12) {
+                case INST_0:
+                        if (opcode == CLEAR_OPCODE) return FLOW_NEXT;
+                        if (opcode == RETURN_OPCODE) return FLOW_RETURN;
+                        return FLOW_INVALID;
+                case INST_1: return FLOW_JUMP;
+                case INST_2: return FLOW_CALL;
+                case INST_3:
+                case INST_4: return FLOW_SKIP;
+                case INST_5:
+                case INST_9: return low_nibble == 0 ? FLOW_SKIP : FLOW_INVALID;
+                case INST_8:
+                        return (low_nibble <= OPCODE_8XY7 ||
+                                low_nibble == OPCODE_8XYE)
+                                   ? FLOW_NEXT
+                                   : FLOW_INVALID;
+                case INST_B: return FLOW_INDIRECT;
+                case INST_E:
+                        return (low_byte == OPCODE_EX9E ||
+                                low_byte == OPCODE_EXA1)
+                                   ? FLOW_SKIP
+                                   : FLOW_INVALID;
+                case INST_F:
+                        switch (low_byte) {
+                                case OPCODE_FX0A: return FLOW_WAIT;
+                                case OPCODE_FX07:
+                                case OPCODE_FX15:
+                                case OPCODE_FX18:
+                                case OPCODE_FX1E:
+                                case OPCODE_FX29:
+                                case OPCODE_FX33:
+                                case OPCODE_FX55:
+                                case OPCODE_FX65: return FLOW_NEXT;
+                                default:          return FLOW_INVALID;
+                        }
+                default: return FLOW_NEXT;
+        }
+}
+
+bool writes_ram(const u16 opcode) {
+        return (opcode >> 12) == INST_F && ((opcode & 0x00FF) == OPCODE_FX33 ||
+                                            (opcode & 0x00FF) == OPCODE_FX55);
+}
+
+// Follows every statically known edge from the entry point, marking which
+// addresses hold reachable instructions and which ones start a basic block.
+void discover(program_t* prog) {
+        static u16 work[RAM_SIZE];
+        u32        pending = 0;
+
+#define ENQUEUE(target)                                             \
+        do {                                                        \
+                const u32 addr_ = (target);                         \
+                if (in_rom(prog, addr_) && !prog->leader[addr_]) { \
+                        prog->leader[addr_] = true;                 \
+                        work[pending++]     = addr_;                \
+                }                                                   \
+        } while (0)
+
+        ENQUEUE(ENTRY_POINT);
+        while (pending > 0) {
+                u16 addr = work[--pending];
+                while (in_rom(prog, addr) && !prog->reachable[addr]) {
+                        const u16    opcode = fetch(prog, addr);
+                        const flow_t flow   = classify(opcode);
+                        if (flow == FLOW_INVALID) {
+                                break;
+                        }
+                        prog->reachable[addr] = true;
+
+                        if (flow == FLOW_NEXT) {
+                                addr += 2;
+                                continue;
+                        }
+
+                        switch (flow) {
+                                case FLOW_JUMP:
+                                        ENQUEUE(opcode & 0x0FFF);
+                                        break;
+                                case FLOW_CALL:
+                                        ENQUEUE(opcode & 0x0FFF);
+                                        ENQUEUE(addr + 2);
+                                        break;
+                                case FLOW_SKIP:
+                                        ENQUEUE(addr + 2);
+                                        ENQUEUE(addr + 4);
+                                        break;
+                                case FLOW_WAIT:
+                                        prog->leader[addr] = true;
+                                        ENQUEUE(addr + 2);
+                                        break;
+                                default: break;
+                        }
+                        break;
+                }
+        }
+
+#undef ENQUEUE
+}
+
+u32 block_length(const program_t* prog, const u16 start) {
+        u32 len = 0;
+        for (u16 addr = start; in_rom(prog, addr); addr += 2) {
+                if ((len > 0 && prog->leader[addr]) || !prog->reachable[addr]) {
+                        break;
+                }
+                len++;
+                if (classify(fetch(prog, addr)) != FLOW_NEXT) {
+                        break;
+                }
+        }
+        return len;
+}
+
+void disassemble(const u16 opcode, char* out, const size_t size) {
+        const u16 nnn = opcode & 0x0FFF;
+        const u8  nn  = opcode & 0x00FF;
+        const u8  n   = opcode & 0x000F;
+        const u8  x   = (opcode >> 8) & 0xF;
+        const u8  y   = (opcode >> 4) & 0xF;
+
+        static const char* alu_ops[] = {
+            [OPCODE_8XY0] = "=",
+            [OPCODE_8XY1] = "|=",
+            [OPCODE_8XY2] = "&=",
+            [OPCODE_8XY3] = "^=",
+            [OPCODE_8XY4] = "+=",
+            [OPCODE_8XY5] = "-=",
+        };
+
+        if (classify(opcode) == FLOW_INVALID) {
+                snprintf(out, size, "data 0x%04X", opcode);
+                return;
+        }
+
+        switch (opcode >> 12) {
+                case INST_0:
+                        snprintf(out,
+                                 size,
+                                 opcode == CLEAR_OPCODE ? "disp_clear()"
+                                                        : "return");
+                        break;
+                case INST_1: snprintf(out, size, "goto 0x%03X", nnn); break;
+                case INST_2: snprintf(out, size, "call 0x%03X", nnn); break;
+                case INST_3:
+                        snprintf(out, size, "if (V[%X] == 0x%02X) skip", x, nn);
+                        break;
+                case INST_4:
+                        snprintf(out, size, "if (V[%X] != 0x%02X) skip", x, nn);
+                        break;
+                case INST_5:
+                        snprintf(out, size, "if (V[%X] == V[%X]) skip", x, y);
+                        break;
+                case INST_6:
+                        snprintf(out, size, "V[%X] = 0x%02X", x, nn);
+                        break;
+                case INST_7:
+                        snprintf(out, size, "V[%X] += 0x%02X", x, nn);
+                        break;
+                case INST_8:
+                        if (n == OPCODE_8XY6) {
+                                snprintf(out, size, "V[%X] >>= 1", x);
+                        } else if (n == OPCODE_8XYE) {
+                                snprintf(out, size, "V[%X] <<= 1", x);
+                        } else if (n == OPCODE_8XY7) {
+                                snprintf(out,
+                                         size,
+                                         "V[%X] = V[%X] - V[%X]",
+                                         x,
+                                         y,
+                                         x);
+                        } else {
+                                snprintf(out,
+                                         size,
+                                         "V[%X] %s V[%X]",
+                                         x,
+                                         alu_ops[n],
+                                         y);
+                        }
+                        break;
+                case INST_9:
+                        snprintf(out, size, "if (V[%X] != V[%X]) skip", x, y);
+                        break;
+                case INST_A: snprintf(out, size, "I = 0x%03X", nnn); break;
+                case INST_B:
+                        snprintf(out, size, "goto V[0] + 0x%03X", nnn);
+                        break;
+                case INST_C:
+                        snprintf(out, size, "V[%X] = rand() & 0x%02X", x, nn);
+                        break;
+                case INST_D:
+                        snprintf(
+                            out, size, "draw(V[%X], V[%X], 0x%X)", x, y, n);
+                        break;
+                case INST_E:
+                        snprintf(out,
+                                 size,
+                                 nn == OPCODE_EX9E ? "if (key(V[%X])) skip"
+                                                   : "if (!key(V[%X])) skip",
+                                 x);
+                        break;
+                case INST_F: {
+                        static const char* formats[] = {
+                            [OPCODE_FX07] = "V[%X] = delay_timer",
+                            [OPCODE_FX0A] = "V[%X] = wait_key()",
+                            [OPCODE_FX15] = "delay_timer = V[%X]",
+                            [OPCODE_FX18] = "sound_timer = V[%X]",
+                            [OPCODE_FX1E] = "I += V[%X]",
+                            [OPCODE_FX29] = "I = font(V[%X])",
+                            [OPCODE_FX33] = "ram[I..I+2] = bcd(V[%X])",
+                            [OPCODE_FX55] = "ram[I..] = V[0]..V[%X]",
+                            [OPCODE_FX65] = "V[0]..V[%X] = ram[I..]",
+                        };
+                        snprintf(out, size, formats[nn], x);
+                        break;
+                }
+        }
+}
+
+void print_successors(const program_t* prog, const u16 last) {
+        const u16 opcode = fetch(prog, last);
+        switch (classify(opcode)) {
+                case FLOW_NEXT:    printf("0x%03X", last + 2); break;
+                case FLOW_JUMP:    printf("0x%03X", opcode & 0x0FFF); break;
+                case FLOW_RETURN:  printf("return"); break;
+                case FLOW_INVALID: break;
+                case FLOW_CALL:
+                        printf("0x%03X (ret 0x%03X)",
+                               opcode & 0x0FFF,
+                               last + 2);
+                        break;
+                case FLOW_SKIP:
+                        printf("0x%03X, 0x%03X", last + 2, last + 4);
+                        break;
+                case FLOW_INDIRECT:
+                        printf("? (V[0] + 0x%03X)", opcode & 0x0FFF);
+                        break;
+                case FLOW_WAIT:
+                        printf("0x%03X, 0x%03X", last, last + 2);
+                        break;
+        }
+}
+
+// Prints the rom grouped by basic block along with each block's successors,
+// spelling out sprites when the block set I right before drawing.
+void dump_cfg(const program_t* prog) {
+        for (u32 start = ENTRY_POINT; start < prog->rom_end; start++) {
+                if (!prog->leader[start] || !prog->reachable[start]) {
+                        continue;
+                }
+
+                const u32 len  = block_length(prog, start);
+                const u16 last = start + ((len - 1) * 2);
+                printf("block 0x%03X (%u) -> ", start, len);
+                print_successors(prog, last);
+                printf("\n");
+
+                i32 index = -1;
+                for (u16 addr = start; addr <= last; addr += 2) {
+                        const u16 opcode = fetch(prog, addr);
+                        char      text[64];
+                        disassemble(opcode, text, sizeof(text));
+                        printf("  0x%03X: %04X  %s\n", addr, opcode, text);
+
+                        if ((opcode >> 12) == INST_A) {
+                                index = opcode & 0x0FFF;
+                        }
+                        if ((opcode >> 12) != INST_D || index < 0) {
+                                continue;
+                        }
+                        for (u8 row = 0; row < (opcode & 0x000F); row++) {
+                                const u8 sprite =
+                                    read_ram(&prog->chip8, index + row);
+                                printf("                ");
+                                for (u8 col = 0; col < SPRITE_WIDTH; col++) {
+                                        putchar((sprite & (MSB_MASK >> col))
+                                                    ? '#'
+                                                    : '.');
+                                }
+                                printf("\n");
+                        }
+                }
+        }
+}
+
+// Block starts get a label in the generated code, jumps to them stay inside
+// it instead of going back through aot_run.
+bool translated(const program_t* prog, const u32 addr) {
+        return in_rom(prog, addr) && prog->leader[addr] &&
+               prog->reachable[addr];
+}
+
+// Carries on at target, leaving the generated code when it isn't translated.
+void emit_goto(FILE*            out,
+               const program_t* prog,
+               const u32        target,
+               const char*      indent) {
+        if (translated(prog, target)) {
+                fprintf(out, "%sgoto L_%03X;\n", indent, target);
+        } else {
+                fprintf(out, "%sAOT_EXIT(0x%03X);\n", indent, target & 0xFFFF);
+        }
+}
+
+// Skips branch straight to both successors.
+void emit_skip(FILE*            out,
+               const program_t* prog,
+               const u16        addr,
+               const char*      condition) {
+        fprintf(out, "        if (%s) {\n", condition);
+        emit_goto(out, prog, addr + 4, "                ");
+        fprintf(out, "        }\n");
+        emit_goto(out, prog, addr + 2, "        ");
+}
+
+// Emits one instruction, charging it to the budget first. Control flow is
+// translated to gotos so PC is only written when leaving the generated code
+// or when a handler reads it.
+void emit_instruction(FILE*            out,
+                      const program_t* prog,
+                      const u16        addr,
+                      const u16        opcode) {
+        const u16 nnn  = opcode & 0x0FFF;
+        const u8  nn   = opcode & 0x00FF;
+        const u8  x    = (opcode >> 8) & 0xF;
+        const u8  y    = (opcode >> 4) & 0xF;
+        const u16 next = addr + 2;
+        char      condition[64];
+
+        fprintf(out, "        AOT_STEP(0x%03X);\n", addr);
+        switch (opcode >> 12) {
+                case INST_0:
+                        if (opcode == CLEAR_OPCODE) {
+                                break;
+                        }
+                        fprintf(out,
+                                "        chip8->sp = (chip8->sp - 1) & "
+                                "STACK_MASK;\n"
+                                "        chip8->PC = "
+                                "chip8->stack[chip8->sp];\n"
+                                "        goto aot_dispatch;\n");
+                        return;
+                case INST_1:
+                        emit_goto(out, prog, nnn, "        ");
+                        return;
+                case INST_2:
+                        fprintf(out,
+                                "        chip8->stack[chip8->sp] = 0x%03X;\n",
+                                next);
+                        fprintf(out,
+                                "        chip8->sp = (chip8->sp + 1) & "
+                                "STACK_MASK;\n");
+                        emit_goto(out, prog, nnn, "        ");
+                        return;
+                case INST_3:
+                case INST_4:
+                        snprintf(condition,
+                                 sizeof(condition),
+                                 "chip8->V[0x%X] %s 0x%02X",
+                                 x,
+                                 (opcode >> 12) == INST_3 ? "==" : "!=",
+                                 nn);
+                        emit_skip(out, prog, addr, condition);
+                        return;
+                case INST_5:
+                case INST_9:
+                        snprintf(condition,
+                                 sizeof(condition),
+                                 "chip8->V[0x%X] %s chip8->V[0x%X]",
+                                 x,
+                                 (opcode >> 12) == INST_5 ? "==" : "!=",
+                                 y);
+                        emit_skip(out, prog, addr, condition);
+                        return;
+                case INST_6:
+                        fprintf(out,
+                                "        chip8->V[0x%X] = 0x%02X;\n",
+                                x,
+                                nn);
+                        return;
+                case INST_7:
+                        fprintf(out,
+                                "        chip8->V[0x%X] += 0x%02X;\n",
+                                x,
+                                nn);
+                        return;
+                case INST_A:
+                        fprintf(out, "        chip8->I = 0x%03X;\n", nnn);
+                        return;
+                case INST_B:
+                        fprintf(out,
+                                "        chip8->PC = 0x%03X + chip8->V[0];\n"
+                                "        goto aot_dispatch;\n",
+                                nnn);
+                        return;
+                case INST_E:
+                        snprintf(condition,
+                                 sizeof(condition),
+                                 "%schip8->keypad[chip8->V[0x%X] & "
+                                 "KEYPAD_MASK]",
+                                 nn == OPCODE_EX9E ? "" : "!",
+                                 x);
+                        emit_skip(out, prog, addr, condition);
+                        return;
+                default: break;
+        }
+
+        // Everything else goes straight to its handler, skipping the fetch
+        // and the table dispatch.
+        fprintf(out, "        chip8->inst.opcode = 0x%04X;\n", opcode);
+        const u8 family = opcode >> 12;
+        if (family == INST_0) {
+                fprintf(out, "        inst_00E0(chip8);\n");
+        } else if (family == INST_8) {
+                fprintf(out, "        inst_8XY%X(chip8);\n", opcode & 0x000F);
+        } else if (family == INST_F && nn == OPCODE_FX0A) {
+                // Waiting for a key moves PC back onto the FX0A.
+                fprintf(out, "        chip8->PC = 0x%03X;\n", next);
+                fprintf(out, "        inst_FX0A(chip8);\n");
+                fprintf(out,
+                        "        if (chip8->PC == 0x%03X) {\n"
+                        "                goto L_%03X;\n"
+                        "        }\n",
+                        addr,
+                        addr);
+        } else if (family == INST_F) {
+                fprintf(out, "        inst_FX%02X(chip8);\n", nn);
+        } else {
+                fprintf(out,
+                        "        %s(chip8);\n",
+                        family == INST_C ? "inst_CXNN" : "inst_DXYN");
+        }
+
+        if (writes_ram(opcode)) {
+                fprintf(out, "        if (!aot_note_write(chip8)) {\n");
+                fprintf(out, "                AOT_EXIT(0x%03X);\n", next);
+                fprintf(out, "        }\n");
+        }
+}
+
+void emit_prologue(FILE* out, const program_t* prog, const char rom_name[]) {
+        fprintf(out,
+                "// Generated by chip8-recomp from %s, do not edit.\n"
+                "#define _GNU_SOURCE\n\n"
+                "#include \"types.h\"\n\n"
+                "void aot_run(chip8_t* chip8, const u32 count);\n\n"
+                "#define CHIP8_RUN aot_run\n"
+                "#include \"main.c\"\n\n",
+                rom_name);
+
+        fprintf(out, "static const u8 aot_rom[] = {");
+        for (u32 addr = ENTRY_POINT; addr < prog->rom_end; addr++) {
+                fprintf(out,
+                        "%s0x%02X,",
+                        (addr - ENTRY_POINT) % 12 == 0 ? "\n    " : " ",
+                        read_ram(&prog->chip8, addr));
+        }
+        fprintf(out, "\n};\n\n");
+
+        fprintf(out,
+                "// Bytes covered by translated code, one bit per "
+                "address.\n");
+        fprintf(out, "static const u8 aot_code_map[%u] = {", RAM_SIZE / 8);
+        for (u32 byte = 0; byte < RAM_SIZE / 8; byte++) {
+                u8 bits = 0;
+                for (u8 bit = 0; bit < 8; bit++) {
+                        const u32 addr = (byte * 8) + bit;
+                        if (prog->reachable[addr] ||
+                            (addr > 0 && prog->reachable[addr - 1])) {
+                                bits |= 1 << bit;
+                        }
+                }
+                if (bits) {
+                        fprintf(out, "\n    [%u] = 0x%02X,", byte, bits);
+                }
+        }
+        fprintf(out, "\n};\n\n");
+
+        fprintf(
+            out,
+            "static bool aot_valid   = true;\n"
+            "static bool aot_checked = false;\n\n"
+            "// Drops every translation once the guest writes over its own\n"
+            "// code, the interpreter then runs whatever it wrote.\n"
+            "static bool aot_note_write(const chip8_t* chip8) {\n"
+            "        const u16 op    = chip8->inst.opcode;\n"
+            "        const u32 first = chip8->I;\n"
+            "        const u32 last  = (op & 0x00FF) == OPCODE_FX33\n"
+            "                              ? first + 2\n"
+            "                              : first + ((op >> 8) & 0xF);\n"
+            "        for (u32 addr = first; addr <= last; addr++) {\n"
+            "                const u8 bit = 1 << (addr & 7);\n"
+            "                if (addr < %u && aot_valid &&\n"
+            "                    (aot_code_map[addr >> 3] & bit)) {\n"
+            "                        TraceLog(LOG_INFO,\n"
+            "                                 \"Rom rewrote code at \"\n"
+            "                                 \"0x%%03X, interpreting\",\n"
+            "                                 addr);\n"
+            "                        aot_valid = false;\n"
+            "                }\n"
+            "        }\n"
+            "        return aot_valid;\n"
+            "}\n\n",
+            RAM_SIZE);
+
+        fprintf(out,
+                "// Every instruction is paid for before it runs, an empty\n"
+                "// budget leaves with PC on the next one.\n"
+                "#define AOT_STEP(addr)                  \\\n"
+                "        if (left == 0) {                \\\n"
+                "                chip8->PC = (addr);     \\\n"
+                "                return budget;          \\\n"
+                "        }                               \\\n"
+                "        left--\n\n"
+                "#define AOT_EXIT(addr)                  \\\n"
+                "        do {                            \\\n"
+                "                chip8->PC = (addr);     \\\n"
+                "                return budget - left;   \\\n"
+                "        } while (0)\n\n");
+}
+
+// One function holds the whole translation. Every block start is a label,
+// known successors are gotos and returns or BNNN go back through the switch
+// on PC, so only the budget or untranslated code leave it.
+void emit_translation(FILE* out, const program_t* prog) {
+        fprintf(out,
+                "// Runs at most `budget` instructions from PC, 0 when PC\n"
+                "// isn't translated.\n"
+                "static u32 aot_exec(chip8_t* chip8, const u32 budget) {\n"
+                "        u32 left = budget;\n\n"
+                "aot_dispatch:\n"
+                "        switch (chip8->PC) {\n");
+        for (u32 start = ENTRY_POINT; start < prog->rom_end; start++) {
+                if (translated(prog, start)) {
+                        fprintf(out,
+                                "                case 0x%03X: goto L_%03X;\n",
+                                start,
+                                start);
+                }
+        }
+        fprintf(out,
+                "                default: return budget - left;\n"
+                "        }\n\n");
+
+        for (u32 start = ENTRY_POINT; start < prog->rom_end; start++) {
+                if (!translated(prog, start)) {
+                        continue;
+                }
+
+                const u32 len = block_length(prog, start);
+                fprintf(out, "L_%03X:\n", start);
+                for (u32 i = 0; i < len; i++) {
+                        const u16 addr   = start + (i * 2);
+                        const u16 opcode = fetch(prog, addr);
+                        char      text[64];
+                        disassemble(opcode, text, sizeof(text));
+                        fprintf(out, "        // 0x%03X: %s\n", addr, text);
+                        emit_instruction(out, prog, addr, opcode);
+                }
+
+                const u16    last = start + ((len - 1) * 2);
+                const flow_t flow = classify(fetch(prog, last));
+                if (flow == FLOW_NEXT || flow == FLOW_WAIT) {
+                        emit_goto(out, prog, last + 2, "        ");
+                }
+                fprintf(out, "\n");
+        }
+        // Roms without a return or BNNN never go back to the switch.
+        fprintf(out, "        goto aot_dispatch;\n}\n\n");
+}
+
+void emit_epilogue(FILE* out) {
+        fprintf(
+            out,
+            "// Runs exactly `count` instructions, the translation gets\n"
+            "// whatever is left of the frame so it stops where the\n"
+            "// interpreter would.\n"
+            "void aot_run(chip8_t* chip8, const u32 count) {\n"
+            "        if (!aot_checked) {\n"
+            "                aot_checked = true;\n"
+            "                if (memcmp(&chip8->image->ram[%u],\n"
+            "                           aot_rom,\n"
+            "                           sizeof(aot_rom)) != 0) {\n"
+            "                        TraceLog(\n"
+            "                            LOG_WARNING,\n"
+            "                            \"Loaded rom differs from the \"\n"
+            "                            \"recompiled one, interpreting\");\n"
+            "                        aot_valid = false;\n"
+            "                }\n"
+            "        }\n\n"
+            "        u32 done = 0;\n"
+            "        while (done < count) {\n"
+            "                const u32 left = count - done;\n"
+            "                const u32 ran  =\n"
+            "                    aot_valid ? aot_exec(chip8, left) : 0;\n"
+            "                if (ran > 0) {\n"
+            "                        done += ran;\n"
+            "                        continue;\n"
+            "                }\n\n"
+            "                emulate_instruction(chip8);\n"
+            "                const u16 op = chip8->inst.opcode;\n"
+            "                if ((op >> 12) == INST_F &&\n"
+            "                    ((op & 0x00FF) == OPCODE_FX33 ||\n"
+            "                     (op & 0x00FF) == OPCODE_FX55)) {\n"
+            "                        aot_note_write(chip8);\n"
+            "                }\n"
+            "                done++;\n"
+            "        }\n"
+            "}\n",
+            ENTRY_POINT);
+}
+
+bool emit_program(const program_t* prog,
+                  const char       rom_name[],
+                  const char       out_name[]) {
+        FILE* out = fopen(out_name, "w");
+        if (!out) {
+                TraceLog(LOG_ERROR, "Couldn't create %s", out_name);
+                return false;
+        }
+
+        emit_prologue(out, prog, rom_name);
+        emit_translation(out, prog);
+        emit_epilogue(out);
+
+        return fclose(out) == 0;
+}
+
+int main(int argc, char* argv[]) {
+        const bool dump = argc == 3 && strcmp(argv[1], "-d") == 0;
+        if (argc != 3) {
+                fprintf(stderr,
+                        "Usage: %s <rom_file> <output.c>\n"
+                        "       %s -d <rom_file>\n",
+                        argv[0],
+                        argv[0]);
+                exit(EXIT_FAILURE);
+        }
+
+        static program_t prog     = {0};
+        const char*      rom_name = dump ? argv[2] : argv[1];
+        if (!init_chip8(&prog.chip8, rom_name)) {
+                exit(EXIT_FAILURE);
+        }
+
+        prog.rom_end = ENTRY_POINT + prog.chip8.image->rom_size;
+        discover(&prog);
+        if (dump) {
+                dump_cfg(&prog);
+                exit(EXIT_SUCCESS);
+        }
+
+        if (!emit_program(&prog, rom_name, argv[2])) {
+                exit(EXIT_FAILURE);
+        }
+        exit(EXIT_SUCCESS);
+}
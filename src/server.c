@@ -0,0 +1,449 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../utils/types.h"
+#include "../utils/stream.h"
+
+#define MAX_SESSIONS       64
+#define MAX_CLIENTS        256
+#define MAX_EVENTS         64
+#define MAX_CATCHUP_FRAMES 4
+#define FRAME_NS           (1000000000L / 60)
+#define ACCEPT_BACKOFF     60  // Frames without accepting after a hard error
+
+// epoll tags, anything below MAX_CLIENTS is a client slot.
+#define LISTEN_TAG 0xFFFFFFF0u
+#define TIMER_TAG  0xFFFFFFF1u
+
+typedef struct {
+        chip8_t chip8;
+        u32     frame;
+} session_t;
+
+typedef struct {
+        int fd;       // -1 when the slot is free
+        i32 session;  // -1 until the client attaches
+        u32 pending;  // Rows changed since the last delta we queued
+        u8  in[sizeof(stream_input_msg_t)];
+        u32 in_len;
+        u8  out[STREAM_MAX_DELTA];
+        u32 out_len;
+        u32 out_off;
+        bool polling_out;  // EPOLLOUT armed because the socket was full
+} client_t;
+
+typedef struct {
+        int       epoll_fd;
+        int       listen_fd;
+        int       timer_fd;
+        u32       accept_backoff;  // Frames until listen_fd is watched again
+        session_t sessions[MAX_SESSIONS];
+        u32       session_count;
+        client_t  clients[MAX_CLIENTS];
+} server_t;
+
+static volatile sig_atomic_t keep_running = 1;
+
+void on_signal(int sig) {
+        (void)sig;
+        keep_running = 0;
+}
+
+bool watch_fd(server_t* server, const int fd, const u32 events, const u32 tag) {
+        struct epoll_event ev = {.events = events, .data.u32 = tag};
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+                TraceLog(LOG_ERROR, "epoll_ctl failed: %s", strerror(errno));
+                return false;
+        }
+        return true;
+}
+
+void set_client_polling_out(server_t* server, const u32 slot, const bool on) {
+        client_t* client = &server->clients[slot];
+        if (client->polling_out == on) {
+                return;
+        }
+
+        struct epoll_event ev = {
+            .events   = EPOLLIN | (on ? EPOLLOUT : 0),
+            .data.u32 = slot,
+        };
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, client->fd, &ev);
+        client->polling_out = on;
+}
+
+void drop_client(server_t* server, const u32 slot) {
+        client_t* client = &server->clients[slot];
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+        close(client->fd);
+        client->fd = -1;
+}
+
+// Serializes the rows a client is missing, taken from the current display
+// rather than queued per frame, so a slow client skips intermediate frames
+// instead of buffering them.
+void queue_delta(const session_t* session, client_t* client) {
+        stream_delta_header_t header = {
+            .frame = session->frame,
+            .rows  = client->pending,
+        };
+        memcpy(client->out, &header, sizeof(header));
+        u32 len = sizeof(header);
+
+        for (u8 row = 0; row < CHIP_HEIGHT; row++) {
+                if (!(client->pending & (1u << row))) {
+                        continue;
+                }
+                const u64 bits = session->chip8.display[row];
+                memcpy(&client->out[len], &bits, sizeof(bits));
+                len += sizeof(bits);
+        }
+
+        client->out_len = len;
+        client->out_off = 0;
+        client->pending = 0;
+}
+
+void flush_client(server_t* server, const u32 slot) {
+        client_t* client = &server->clients[slot];
+        if (client->session < 0) {
+                return;
+        }
+
+        if (client->out_len == 0) {
+                if (client->pending == 0) {
+                        return;
+                }
+                queue_delta(&server->sessions[client->session], client);
+        }
+
+        while (client->out_off < client->out_len) {
+                const ssize_t sent = send(client->fd,
+                                          &client->out[client->out_off],
+                                          client->out_len - client->out_off,
+                                          MSG_NOSIGNAL);
+                if (sent < 0) {
+                        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                                set_client_polling_out(server, slot, true);
+                                return;
+                        }
+                        drop_client(server, slot);
+                        return;
+                }
+                client->out_off += (u32)sent;
+        }
+
+        client->out_len = 0;
+        set_client_polling_out(server, slot, false);
+}
+
+void handle_client_message(server_t* server, const u32 slot) {
+        client_t*          client = &server->clients[slot];
+        stream_input_msg_t msg;
+        memcpy(&msg, client->in, sizeof(msg));
+
+        switch (msg.type) {
+                case STREAM_MSG_ATTACH:
+                        if (msg.session >= server->session_count) {
+                                TraceLog(LOG_WARNING,
+                                         "Client asked for unknown session %u",
+                                         msg.session);
+                                drop_client(server, slot);
+                                return;
+                        }
+                        client->session = msg.session;
+                        client->pending = ALL_ROWS_DIRTY;
+                        flush_client(server, slot);
+                        break;
+                case STREAM_MSG_KEYS: {
+                        if (client->session < 0) {
+                                break;
+                        }
+                        session_t* session = &server->sessions[client->session];
+                        for (u8 key = 0; key < KEYPAD_SIZE; key++) {
+                                session->chip8.keypad[key] =
+                                    (msg.keys >> key) & 0x1;
+                        }
+                        break;
+                }
+                default:
+                        TraceLog(LOG_WARNING,
+                                 "Unknown message type 0x%02X",
+                                 msg.type);
+                        drop_client(server, slot);
+                        break;
+        }
+}
+
+void read_client(server_t* server, const u32 slot) {
+        client_t* client = &server->clients[slot];
+        for (;;) {
+                const ssize_t got = recv(client->fd,
+                                         &client->in[client->in_len],
+                                         sizeof(client->in) - client->in_len,
+                                         0);
+                if (got == 0) {
+                        drop_client(server, slot);
+                        return;
+                }
+                if (got < 0) {
+                        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                                drop_client(server, slot);
+                        }
+                        return;
+                }
+
+                client->in_len += (u32)got;
+                if (client->in_len == sizeof(client->in)) {
+                        client->in_len = 0;
+                        handle_client_message(server, slot);
+                        if (client->fd < 0) {
+                                return;
+                        }
+                }
+        }
+}
+
+void accept_clients(server_t* server) {
+        for (;;) {
+                const int fd = accept4(server->listen_fd,
+                                       NULL,
+                                       NULL,
+                                       SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0 && (errno == EINTR || errno == ECONNABORTED)) {
+                        continue;
+                }
+                if (fd < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                        return;
+                }
+                if (fd < 0) {
+                        // Out of fds or memory, the pending connection keeps
+                        // listen_fd readable so stop watching it for a while
+                        // instead of spinning on epoll_wait.
+                        TraceLog(LOG_ERROR,
+                                 "accept4 failed: %s, pausing accepts",
+                                 strerror(errno));
+                        epoll_ctl(server->epoll_fd,
+                                  EPOLL_CTL_DEL,
+                                  server->listen_fd,
+                                  NULL);
+                        server->accept_backoff = ACCEPT_BACKOFF;
+                        return;
+                }
+
+                u32 slot = 0;
+                while (slot < MAX_CLIENTS && server->clients[slot].fd >= 0) {
+                        slot++;
+                }
+                if (slot == MAX_CLIENTS) {
+                        TraceLog(LOG_WARNING, "Too many clients, refusing one");
+                        close(fd);
+                        continue;
+                }
+
+                server->clients[slot] = (client_t){.fd = fd, .session = -1};
+                if (!watch_fd(server, fd, EPOLLIN, slot)) {
+                        close(fd);
+                        server->clients[slot].fd = -1;
+                }
+        }
+}
+
+// Runs one 60hz frame on every session and hands the rows each one touched to
+// the clients watching it.
+void run_frame(server_t* server) {
+        for (u32 s = 0; s < server->session_count; s++) {
+                session_t* session = &server->sessions[s];
+                chip8_t*   chip8   = &session->chip8;
+                if (chip8->state != RUNNING) {
+                        continue;
+                }
+
+                emulate_frame(chip8);
+                session->frame++;
+        }
+
+        for (u32 slot = 0; slot < MAX_CLIENTS; slot++) {
+                client_t* client = &server->clients[slot];
+                if (client->fd < 0 || client->session < 0) {
+                        continue;
+                }
+                client->pending |=
+                    server->sessions[client->session].chip8.dirty_rows;
+        }
+
+        for (u32 s = 0; s < server->session_count; s++) {
+                server->sessions[s].chip8.dirty_rows = 0;
+        }
+
+        for (u32 slot = 0; slot < MAX_CLIENTS; slot++) {
+                if (server->clients[slot].fd >= 0 &&
+                    server->clients[slot].out_len == 0) {
+                        flush_client(server, slot);
+                }
+        }
+}
+
+bool init_server(server_t* server, const char socket_path[]) {
+        for (u32 slot = 0; slot < MAX_CLIENTS; slot++) {
+                server->clients[slot].fd = -1;
+        }
+
+        struct sockaddr_un addr = {.sun_family = AF_UNIX};
+        if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+                TraceLog(LOG_ERROR, "Socket path %s is too long", socket_path);
+                return false;
+        }
+        strcpy(addr.sun_path, socket_path);
+        unlink(socket_path);
+
+        server->listen_fd =
+            socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (server->listen_fd < 0 ||
+            bind(server->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) !=
+                0 ||
+            listen(server->listen_fd, SOMAXCONN) != 0) {
+                TraceLog(LOG_ERROR,
+                         "Couldn't listen on %s: %s",
+                         socket_path,
+                         strerror(errno));
+                return false;
+        }
+
+        server->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+        const struct itimerspec period = {
+            .it_interval = {.tv_nsec = FRAME_NS},
+            .it_value    = {.tv_nsec = FRAME_NS},
+        };
+        if (server->timer_fd < 0 ||
+            timerfd_settime(server->timer_fd, 0, &period, NULL) != 0) {
+                TraceLog(LOG_ERROR, "Couldn't create frame timer");
+                return false;
+        }
+
+        server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (server->epoll_fd < 0) {
+                TraceLog(LOG_ERROR,
+                         "epoll_create1 failed: %s",
+                         strerror(errno));
+                return false;
+        }
+
+        return watch_fd(server, server->listen_fd, EPOLLIN, LISTEN_TAG) &&
+               watch_fd(server, server->timer_fd, EPOLLIN, TIMER_TAG);
+}
+
+void run_server(server_t* server) {
+        struct epoll_event events[MAX_EVENTS];
+        while (keep_running) {
+                const int count =
+                    epoll_wait(server->epoll_fd, events, MAX_EVENTS, -1);
+                if (count < 0) {
+                        if (errno == EINTR) {
+                                continue;
+                        }
+                        TraceLog(LOG_ERROR, "epoll_wait: %s", strerror(errno));
+                        return;
+                }
+
+                for (int i = 0; i < count; i++) {
+                        const u32 tag = events[i].data.u32;
+                        if (tag == LISTEN_TAG) {
+                                accept_clients(server);
+                        } else if (tag == TIMER_TAG) {
+                                u64 expirations = 0;
+                                if (read(server->timer_fd,
+                                         &expirations,
+                                         sizeof(expirations)) !=
+                                    sizeof(expirations)) {
+                                        continue;
+                                }
+                                if (expirations > MAX_CATCHUP_FRAMES) {
+                                        expirations = MAX_CATCHUP_FRAMES;
+                                }
+                                while (expirations--) {
+                                        run_frame(server);
+                                }
+                                if (server->accept_backoff > 0 &&
+                                    --server->accept_backoff == 0) {
+                                        watch_fd(server,
+                                                 server->listen_fd,
+                                                 EPOLLIN,
+                                                 LISTEN_TAG);
+                                }
+                        } else if (server->clients[tag].fd >= 0) {
+                                if (events[i].events & EPOLLOUT) {
+                                        flush_client(server, tag);
+                                }
+                                if (server->clients[tag].fd >= 0 &&
+                                    events[i].events &
+                                        (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                                        read_client(server, tag);
+                                }
+                        }
+                }
+        }
+}
+
+int main(int argc, char* argv[]) {
+        if (argc < 3) {
+                fprintf(stderr,
+                        "Usage: %s <socket_path> <rom_file> [rom_file...]\n",
+                        argv[0]);
+                exit(EXIT_FAILURE);
+        }
+
+        const char* socket_path = argv[1];
+        if (argc - 2 > MAX_SESSIONS) {
+                fprintf(stderr,
+                        "At most %d sessions per server\n",
+                        MAX_SESSIONS);
+                exit(EXIT_FAILURE);
+        }
+
+        // Sessions of the same rom share one image.
+        static server_t server = {0};
+        for (int i = 2; i < argc; i++) {
+                chip8_t* chip8 = &server.sessions[server.session_count].chip8;
+                for (u32 s = 0; s < server.session_count; s++) {
+                        const chip8_t* other = &server.sessions[s].chip8;
+                        if (strcmp(other->rom_name, argv[i]) == 0) {
+                                init_chip8_from_image(chip8, other->image);
+                                break;
+                        }
+                }
+                if (!chip8->image && !init_chip8(chip8, argv[i])) {
+                        exit(EXIT_FAILURE);
+                }
+                server.session_count++;
+        }
+
+        if (!init_server(&server, socket_path)) {
+                exit(EXIT_FAILURE);
+        }
+
+        struct sigaction action = {.sa_handler = on_signal};
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+
+        TraceLog(LOG_INFO,
+                 "Serving %u session(s) on %s",
+                 server.session_count,
+                 socket_path);
+        run_server(&server);
+
+        unlink(socket_path);
+        exit(EXIT_SUCCESS);
+}
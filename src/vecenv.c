@@ -0,0 +1,252 @@
+#define _GNU_SOURCE
+
+#include "../utils/vecenv.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "../utils/types.h"
+
+#define PACKED_OBS_SIZE (CHIP_HEIGHT * sizeof(u64))
+#define BYTES_OBS_SIZE  DISLPAY_SIZE
+#define SHM_ALIGNMENT   64
+
+struct chip8_snapshot {
+        chip8_t chip8;
+};
+
+struct chip8_vecenv {
+        u32                    num_envs;
+        chip8_obs_format_t     format;
+        char*                  rom_path;
+        char*                  shm_name;  // NULL for a private mapping
+        u8*                    shm;
+        size_t                 shm_size;
+        chip8_vecenv_header_t* header;
+        chip8_t                initial;  // State right after loading the rom
+        chip8_t*               envs;     // All share the initial image
+};
+
+static size_t align_up(const size_t size) {
+        return (size + SHM_ALIGNMENT - 1) & ~(size_t)(SHM_ALIGNMENT - 1);
+}
+
+static u8* env_observation(const chip8_vecenv_t* env, const u32 index) {
+        return env->shm + env->header->obs_offset +
+               ((size_t)index * env->header->obs_stride);
+}
+
+// Writes only the rows the machine touched since the last observation.
+static void write_observation(chip8_vecenv_t* env, const u32 index) {
+        chip8_t* chip8 = &env->envs[index];
+        u8*      obs   = env_observation(env, index);
+
+        for (u8 row = 0; row < CHIP_HEIGHT; row++) {
+                if (!(chip8->dirty_rows & (1u << row))) {
+                        continue;
+                }
+
+                const u64 bits = chip8->display[row];
+                if (env->format == CHIP8_OBS_PACKED) {
+                        memcpy(&obs[row * sizeof(bits)], &bits, sizeof(bits));
+                } else {
+                        u8* line = &obs[row * CHIP_WIDTH];
+                        for (u8 col = 0; col < CHIP_WIDTH; col++) {
+                                line[col] =
+                                    (bits >> (CHIP_WIDTH - 1 - col)) & 0x1;
+                        }
+                }
+        }
+        chip8->dirty_rows = 0;
+
+        env->shm[env->header->done_offset + index] = chip8->state == QUIT;
+}
+
+static bool map_shared_memory(chip8_vecenv_t* env, const char* shm_name) {
+        if (!shm_name) {
+                env->shm = mmap(NULL,
+                                env->shm_size,
+                                PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_ANONYMOUS,
+                                -1,
+                                0);
+                return env->shm != MAP_FAILED;
+        }
+
+        const int fd = shm_open(shm_name, O_CREAT | O_RDWR, 0600);
+        if (fd < 0) {
+                TraceLog(LOG_ERROR, "Couldn't open shared memory %s", shm_name);
+                return false;
+        }
+        if (ftruncate(fd, (off_t)env->shm_size) != 0) {
+                TraceLog(LOG_ERROR,
+                         "Couldn't resize shared memory %s",
+                         shm_name);
+                close(fd);
+                shm_unlink(shm_name);
+                return false;
+        }
+
+        env->shm = mmap(
+            NULL, env->shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (env->shm == MAP_FAILED) {
+                shm_unlink(shm_name);
+                return false;
+        }
+
+        env->shm_name = strdup(shm_name);
+        return true;
+}
+
+chip8_vecenv_t* chip8_vecenv_create(const char*              rom_path,
+                                    const uint32_t           num_envs,
+                                    const chip8_obs_format_t format,
+                                    const char*              shm_name) {
+        if (num_envs == 0 ||
+            (format != CHIP8_OBS_PACKED && format != CHIP8_OBS_BYTES)) {
+                TraceLog(LOG_ERROR,
+                         "Invalid vecenv size or observation format");
+                return NULL;
+        }
+
+        chip8_vecenv_t* env = calloc(1, sizeof(*env));
+        if (!env) {
+                return NULL;
+        }
+        env->num_envs = num_envs;
+        env->format   = format;
+        env->rom_path = strdup(rom_path);
+        env->envs     = calloc(num_envs, sizeof(*env->envs));
+        if (!env->rom_path || !env->envs ||
+            !init_chip8(&env->initial, env->rom_path)) {
+                chip8_vecenv_destroy(env);
+                return NULL;
+        }
+
+        const size_t obs_stride =
+            format == CHIP8_OBS_PACKED ? PACKED_OBS_SIZE : BYTES_OBS_SIZE;
+        const size_t obs_offset = align_up(sizeof(chip8_vecenv_header_t));
+        const size_t done_offset =
+            align_up(obs_offset + (obs_stride * num_envs));
+        env->shm_size = align_up(done_offset + num_envs);
+
+        if (!map_shared_memory(env, shm_name)) {
+                env->shm = NULL;
+                chip8_vecenv_destroy(env);
+                return NULL;
+        }
+
+        env->header  = (chip8_vecenv_header_t*)env->shm;
+        *env->header = (chip8_vecenv_header_t){
+            .magic       = CHIP8_VECENV_MAGIC,
+            .version     = CHIP8_VECENV_VERSION,
+            .num_envs    = num_envs,
+            .format      = format,
+            .width       = CHIP_WIDTH,
+            .height      = CHIP_HEIGHT,
+            .obs_offset  = (u32)obs_offset,
+            .obs_stride  = (u32)obs_stride,
+            .done_offset = (u32)done_offset,
+        };
+
+        chip8_vecenv_reset(env, NULL, NULL);
+        return env;
+}
+
+void chip8_vecenv_destroy(chip8_vecenv_t* env) {
+        if (!env) {
+                return;
+        }
+        if (env->shm) {
+                munmap(env->shm, env->shm_size);
+        }
+        if (env->shm_name) {
+                shm_unlink(env->shm_name);
+        }
+        for (u32 i = 0; env->envs && i < env->num_envs; i++) {
+                release_chip8(&env->envs[i]);
+        }
+        release_chip8(&env->initial);
+        free(env->shm_name);
+        free(env->rom_path);
+        free(env->envs);
+        free(env);
+}
+
+uint32_t chip8_vecenv_num_envs(const chip8_vecenv_t* env) {
+        return env->num_envs;
+}
+
+void* chip8_vecenv_shm(const chip8_vecenv_t* env) {
+        return env->shm;
+}
+
+size_t chip8_vecenv_shm_size(const chip8_vecenv_t* env) {
+        return env->shm_size;
+}
+
+void chip8_vecenv_step(chip8_vecenv_t* env,
+                       const uint16_t* keys,
+                       const uint32_t  frames) {
+        for (u32 i = 0; i < env->num_envs; i++) {
+                chip8_t* chip8 = &env->envs[i];
+                if (keys) {
+                        for (u8 key = 0; key < KEYPAD_SIZE; key++) {
+                                chip8->keypad[key] = (keys[i] >> key) & 0x1;
+                        }
+                }
+
+                for (u32 frame = 0; frame < frames && chip8->state != QUIT;
+                     frame++) {
+                        emulate_frame(chip8);
+                }
+                write_observation(env, i);
+        }
+
+        __atomic_add_fetch(&env->header->steps, 1, __ATOMIC_RELEASE);
+}
+
+void chip8_vecenv_reset(chip8_vecenv_t*         env,
+                        const uint8_t*          mask,
+                        const chip8_snapshot_t* snapshot) {
+        const chip8_t* source = snapshot ? &snapshot->chip8 : &env->initial;
+
+        for (u32 i = 0; i < env->num_envs; i++) {
+                if (mask && !mask[i]) {
+                        continue;
+                }
+                release_chip8(&env->envs[i]);
+                copy_chip8(&env->envs[i], source);
+                env->envs[i].dirty_rows = ALL_ROWS_DIRTY;
+                write_observation(env, i);
+        }
+
+        __atomic_add_fetch(&env->header->steps, 1, __ATOMIC_RELEASE);
+}
+
+chip8_snapshot_t* chip8_vecenv_snapshot(const chip8_vecenv_t* env,
+                                        const uint32_t        index) {
+        if (index >= env->num_envs) {
+                return NULL;
+        }
+
+        chip8_snapshot_t* snapshot = calloc(1, sizeof(*snapshot));
+        if (snapshot) {
+                copy_chip8(&snapshot->chip8, &env->envs[index]);
+        }
+        return snapshot;
+}
+
+void chip8_snapshot_free(chip8_snapshot_t* snapshot) {
+        if (snapshot) {
+                release_chip8(&snapshot->chip8);
+        }
+        free(snapshot);
+}
@@ -0,0 +1,508 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+
+// Interactive debugger for the interpreter. Nothing here runs per instruction:
+// breakpoints are FUSION_TRAP entries swapped into the machine's own copy of
+// the fusion table and watchpoints mark pages so their writes take the copy
+// on write slow path. With nothing set the machine runs at full speed.
+
+#define MAX_BREAKPOINTS 32
+#define MAX_WATCHPOINTS 16
+#define REG_I           REGISTERS_SIZE  // Condition on I instead of a Vx
+#define NO_RESUME       -1
+
+typedef enum {
+        COND_NONE,
+        COND_EQ,
+        COND_NE,
+        COND_LT,
+        COND_GT,
+        NUM_OF_CONDS,
+} condition_op_t;
+
+const char* condition_lookup[NUM_OF_CONDS] = {
+    [COND_NONE] = "",
+    [COND_EQ]   = "==",
+    [COND_NE]   = "!=",
+    [COND_LT]   = "<",
+    [COND_GT]   = ">",
+};
+
+typedef struct {
+        bool           active;
+        u16            addr;
+        condition_op_t op;
+        u8             reg;  // V0-VF or REG_I
+        u16            value;
+} breakpoint_t;
+
+typedef struct {
+        bool active;
+        u16  addr;
+        u16  len;
+} watchpoint_t;
+
+typedef struct {
+        breakpoint_t breakpoints[MAX_BREAKPOINTS];
+        watchpoint_t watchpoints[MAX_WATCHPOINTS];
+        bool         stopped;      // Paused by the debugger, prompt pending
+        i32          resume_pc;    // Trap to step over once when resuming
+        i32          stop_pc;      // Trap left by a watchpoint hit
+        u32          frames_left;  // Frames until run-to-frame stops, 0 = off
+        char         reason[80];
+
+        // Fusion entries as they were before a trap replaced or dropped
+        // them, restored once the last trap around them is gone. Kept by
+        // address since breakpoints and the watchpoint stop share traps.
+        u8   saved_fusion[RAM_SIZE];
+        bool fusion_saved[RAM_SIZE];
+} debugger_t;
+
+bool trap_in_use(const debugger_t* dbg, const u16 addr) {
+        if (dbg->stop_pc == addr) {
+                return true;
+        }
+        for (u32 i = 0; i < MAX_BREAKPOINTS; i++) {
+                if (dbg->breakpoints[i].active &&
+                    dbg->breakpoints[i].addr == addr) {
+                        return true;
+                }
+        }
+        return false;
+}
+
+// First address whose fused sequence could run over addr, fusions never
+// cross a page.
+u16 trap_window_start(const u16 addr) {
+        const u16 offset = addr & PAGE_MASK;
+        return addr - (offset < MAX_FUSION_BYTES - 1 ? offset
+                                                      : MAX_FUSION_BYTES - 1);
+}
+
+// True when a live trap sits at addr or a fusion at addr would run over one.
+bool near_trap(const debugger_t* dbg, const u16 addr) {
+        for (u16 at = addr; at < addr + MAX_FUSION_BYTES; at++) {
+                if ((at >> PAGE_SHIFT) == (addr >> PAGE_SHIFT) &&
+                    trap_in_use(dbg, at)) {
+                        return true;
+                }
+        }
+        return false;
+}
+
+// Swaps the fusion entry at addr for a trap. Fused sequences running over
+// addr are dropped too so they can't skip past it.
+void set_trap(chip8_t* chip8, const u16 addr) {
+        debugger_t* dbg    = chip8->debugger;
+        const u16   masked = addr & RAM_MASK;
+        const u8    page   = masked >> PAGE_SHIFT;
+        if (!(chip8->private_pages & (1u << page))) {
+                make_page_private(chip8, page);
+        }
+
+        const u8* fusion = chip8->fusion_pages[page];
+        for (u16 at = trap_window_start(masked); at <= masked; at++) {
+                if (!dbg->fusion_saved[at]) {
+                        dbg->saved_fusion[at] = fusion[at & PAGE_MASK];
+                        dbg->fusion_saved[at] = true;
+                }
+        }
+        invalidate_fusions(chip8, page, masked & PAGE_MASK);
+        chip8->fusion_pages[page][masked & PAGE_MASK] = FUSION_TRAP;
+}
+
+// Puts back the fusions set_trap dropped, unless another trap still needs
+// them gone or the program rewrote the code under them. A page left equal to
+// the image is shared again.
+void clear_trap(chip8_t* chip8, const u16 addr) {
+        debugger_t* dbg    = chip8->debugger;
+        const u16   masked = addr & RAM_MASK;
+        if (trap_in_use(dbg, masked)) {
+                return;
+        }
+
+        const u8  page   = masked >> PAGE_SHIFT;
+        u8*       fusion = chip8->fusion_pages[page];
+        const u8* ram    = chip8->pages[page];
+        fusion[masked & PAGE_MASK] = FUSION_NONE;
+        for (u16 at = trap_window_start(masked); at <= masked; at++) {
+                if (!dbg->fusion_saved[at] || near_trap(dbg, at)) {
+                        continue;
+                }
+
+                const u8 offset = at & PAGE_MASK;
+                const u8 saved  = dbg->saved_fusion[at];
+                if (saved != FUSION_NONE &&
+                    match_fusion_bytes(&ram[offset]) == saved) {
+                        fusion[offset] = saved;
+                }
+                dbg->fusion_saved[at] = false;
+        }
+
+        const u8* image_ram    = &chip8->image->ram[page * PAGE_SIZE];
+        const u8* image_fusion = &chip8->image->fusion[page * PAGE_SIZE];
+        if ((chip8->private_pages & (1u << page)) &&
+            memcmp(ram, image_ram, PAGE_SIZE) == 0 &&
+            memcmp(fusion, image_fusion, PAGE_SIZE) == 0) {
+                make_page_shared(chip8, page);
+        }
+}
+
+void stop_debugger(chip8_t* chip8, debugger_t* dbg) {
+        dbg->stopped     = true;
+        dbg->frames_left = 0;
+        chip8->state     = PAUSED;
+}
+
+bool condition_holds(const chip8_t* chip8, const breakpoint_t* bp) {
+        const u16 reg = bp->reg == REG_I ? chip8->I : chip8->V[bp->reg];
+        switch (bp->op) {
+                case COND_EQ: return reg == bp->value;
+                case COND_NE: return reg != bp->value;
+                case COND_LT: return reg < bp->value;
+                case COND_GT: return reg > bp->value;
+                default:      return true;
+        }
+}
+
+bool debugger_on_trap(chip8_t* chip8) {
+        debugger_t* dbg = chip8->debugger;
+        const u16   pc  = chip8->PC & RAM_MASK;
+
+        if (dbg->resume_pc == pc) {
+                dbg->resume_pc = NO_RESUME;
+                return false;
+        }
+
+        if (dbg->stop_pc == pc) {
+                dbg->stop_pc = NO_RESUME;
+                clear_trap(chip8, pc);
+                stop_debugger(chip8, dbg);
+                return true;
+        }
+
+        for (u32 i = 0; i < MAX_BREAKPOINTS; i++) {
+                const breakpoint_t* bp = &dbg->breakpoints[i];
+                if (bp->active && bp->addr == pc &&
+                    condition_holds(chip8, bp)) {
+                        snprintf(dbg->reason,
+                                 sizeof(dbg->reason),
+                                 "breakpoint %u at 0x%03X",
+                                 i,
+                                 pc);
+                        stop_debugger(chip8, dbg);
+                        return true;
+                }
+        }
+        return false;
+}
+
+// The write already happened and PC points at the next instruction, so the
+// machine stops there through a one shot trap.
+void debugger_on_write(chip8_t* chip8, const u16 addr) {
+        debugger_t* dbg = chip8->debugger;
+        if (dbg->stop_pc != NO_RESUME) {
+                return;  // Report the first write of an instruction
+        }
+        for (u32 i = 0; i < MAX_WATCHPOINTS; i++) {
+                const watchpoint_t* wp = &dbg->watchpoints[i];
+                if (!wp->active || addr < wp->addr ||
+                    addr >= wp->addr + wp->len) {
+                        continue;
+                }
+
+                snprintf(dbg->reason,
+                         sizeof(dbg->reason),
+                         "watchpoint %u: ram[0x%03X] = 0x%02X",
+                         i,
+                         addr,
+                         read_ram(chip8, addr));
+                dbg->stop_pc = chip8->PC & RAM_MASK;
+                set_trap(chip8, dbg->stop_pc);
+                return;
+        }
+}
+
+void update_watched_pages(chip8_t* chip8) {
+        const debugger_t* dbg     = chip8->debugger;
+        u16               watched = 0;
+        for (u32 i = 0; i < MAX_WATCHPOINTS; i++) {
+                const watchpoint_t* wp = &dbg->watchpoints[i];
+                if (!wp->active) {
+                        continue;
+                }
+                for (u32 addr = wp->addr; addr < (u32)wp->addr + wp->len;
+                     addr++) {
+                        watched |= 1u << ((addr & RAM_MASK) >> PAGE_SHIFT);
+                }
+        }
+        chip8->watched_pages  = watched;
+        chip8->writable_pages = chip8->private_pages & ~watched;
+}
+
+void attach_debugger(chip8_t* chip8, debugger_t* dbg) {
+        memset(dbg, 0, sizeof(*dbg));
+        dbg->resume_pc  = NO_RESUME;
+        dbg->stop_pc    = NO_RESUME;
+        chip8->debugger = dbg;
+        chip8->on_trap  = debugger_on_trap;
+        chip8->on_write = debugger_on_write;
+        enable_fusion(chip8);  // Traps live in the fusion table
+
+        snprintf(dbg->reason, sizeof(dbg->reason), "attached");
+        stop_debugger(chip8, dbg);
+}
+
+// Frontends call this once per frame while a debugger is attached.
+void debugger_end_frame(chip8_t* chip8) {
+        debugger_t* dbg = chip8->debugger;
+        if (dbg->frames_left > 0 && --dbg->frames_left == 0) {
+                snprintf(dbg->reason, sizeof(dbg->reason), "frame reached");
+                stop_debugger(chip8, dbg);
+        }
+}
+
+void debugger_interrupt(chip8_t* chip8) {
+        debugger_t* dbg = chip8->debugger;
+        snprintf(dbg->reason, sizeof(dbg->reason), "interrupted");
+        stop_debugger(chip8, dbg);
+}
+
+void resume(chip8_t* chip8, debugger_t* dbg) {
+        const u16 pc = chip8->PC & RAM_MASK;
+        dbg->resume_pc =
+            chip8->fusion_pages[pc >> PAGE_SHIFT][pc & PAGE_MASK] == FUSION_TRAP
+                ? pc
+                : NO_RESUME;
+        dbg->stopped = false;
+        chip8->state = RUNNING;
+}
+
+void print_registers(const chip8_t* chip8) {
+        printf("PC=0x%03X  I=0x%03X  SP=%u  DT=%u  ST=%u  next=%04X\n",
+               chip8->PC,
+               chip8->I,
+               chip8->sp,
+               chip8->delay_timer,
+               chip8->sound_timer,
+               fetch_opcode(chip8, chip8->PC));
+        for (u8 i = 0; i < REGISTERS_SIZE; i++) {
+                printf("V%X=%02X%s", i, chip8->V[i], i % 8 == 7 ? "\n" : "  ");
+        }
+}
+
+void print_points(const debugger_t* dbg) {
+        for (u32 i = 0; i < MAX_BREAKPOINTS; i++) {
+                const breakpoint_t* bp = &dbg->breakpoints[i];
+                if (!bp->active) {
+                        continue;
+                }
+                printf("b%u  0x%03X", i, bp->addr);
+                if (bp->op != COND_NONE) {
+                        if (bp->reg == REG_I) {
+                                printf(" if I");
+                        } else {
+                                printf(" if V%X", bp->reg);
+                        }
+                        printf(" %s 0x%X", condition_lookup[bp->op], bp->value);
+                }
+                printf("\n");
+        }
+        for (u32 i = 0; i < MAX_WATCHPOINTS; i++) {
+                const watchpoint_t* wp = &dbg->watchpoints[i];
+                if (wp->active) {
+                        printf("w%u  0x%03X..0x%03X\n",
+                               i,
+                               wp->addr,
+                               wp->addr + wp->len - 1);
+                }
+        }
+}
+
+bool parse_condition(breakpoint_t* bp, const char* reg, const char* op) {
+        if (strcmp(reg, "I") == 0) {
+                bp->reg = REG_I;
+        } else if ((reg[0] == 'V' || reg[0] == 'v') && reg[1] && !reg[2]) {
+                bp->reg = (u8)strtoul(&reg[1], NULL, 16);
+        } else {
+                return false;
+        }
+
+        for (u32 cond = COND_EQ; cond < NUM_OF_CONDS; cond++) {
+                if (strcmp(op, condition_lookup[cond]) == 0) {
+                        bp->op = cond;
+                        return true;
+                }
+        }
+        return false;
+}
+
+void add_breakpoint(chip8_t* chip8, debugger_t* dbg, char* args) {
+        char* addr  = strtok(args, " \t\n");
+        char* kw    = strtok(NULL, " \t\n");
+        char* reg   = strtok(NULL, " \t\n");
+        char* op    = strtok(NULL, " \t\n");
+        char* value = strtok(NULL, " \t\n");
+        if (!addr) {
+                printf("usage: b <addr> [if <Vx|I> <op> <value>]\n");
+                return;
+        }
+
+        breakpoint_t bp = {
+            .active = true,
+            .addr   = strtoul(addr, NULL, 0) & RAM_MASK,
+        };
+        if (kw) {
+                if (strcmp(kw, "if") != 0 || !reg || !op || !value ||
+                    !parse_condition(&bp, reg, op)) {
+                        printf("bad condition, e.g. b 0x2A0 if V3 == 0x10\n");
+                        return;
+                }
+                bp.value = strtoul(value, NULL, 0);
+        }
+
+        for (u32 i = 0; i < MAX_BREAKPOINTS; i++) {
+                if (!dbg->breakpoints[i].active) {
+                        dbg->breakpoints[i] = bp;
+                        set_trap(chip8, bp.addr);
+                        printf("b%u at 0x%03X\n", i, bp.addr);
+                        return;
+                }
+        }
+        printf("too many breakpoints\n");
+}
+
+void add_watchpoint(chip8_t* chip8, debugger_t* dbg, char* args) {
+        char* addr = strtok(args, " \t\n");
+        char* len  = strtok(NULL, " \t\n");
+        if (!addr) {
+                printf("usage: w <addr> [len]\n");
+                return;
+        }
+
+        const watchpoint_t wp = {
+            .active = true,
+            .addr   = strtoul(addr, NULL, 0) & RAM_MASK,
+            .len    = len ? strtoul(len, NULL, 0) : 1,
+        };
+        for (u32 i = 0; i < MAX_WATCHPOINTS; i++) {
+                if (!dbg->watchpoints[i].active) {
+                        dbg->watchpoints[i] = wp;
+                        update_watched_pages(chip8);
+                        printf("w%u at 0x%03X\n", i, wp.addr);
+                        return;
+                }
+        }
+        printf("too many watchpoints\n");
+}
+
+void delete_point(chip8_t* chip8, debugger_t* dbg, char* args) {
+        const char* id = strtok(args, " \t\n");
+        if (!id || (id[0] != 'b' && id[0] != 'w')) {
+                printf("usage: d <bN|wN>\n");
+                return;
+        }
+
+        const u32 index = strtoul(&id[1], NULL, 10);
+        if (id[0] == 'b' && index < MAX_BREAKPOINTS &&
+            dbg->breakpoints[index].active) {
+                dbg->breakpoints[index].active = false;
+                clear_trap(chip8, dbg->breakpoints[index].addr);
+        } else if (id[0] == 'w' && index < MAX_WATCHPOINTS) {
+                dbg->watchpoints[index].active = false;
+                update_watched_pages(chip8);
+        }
+}
+
+void dump_ram(const chip8_t* chip8, char* args) {
+        const char* addr = strtok(args, " \t\n");
+        const char* len  = strtok(NULL, " \t\n");
+        const u16   from = addr ? strtoul(addr, NULL, 0) : chip8->I;
+        const u16   size = len ? strtoul(len, NULL, 0) : 16;
+
+        for (u16 i = 0; i < size; i++) {
+                if (i % 16 == 0) {
+                        printf("%s0x%03X:",
+                               i ? "\n" : "",
+                               (from + i) & RAM_MASK);
+                }
+                printf(" %02X", read_ram(chip8, from + i));
+        }
+        printf("\n");
+}
+
+// Reads commands from stdin until one of them resumes the machine.
+void debugger_prompt(chip8_t* chip8) {
+        debugger_t* dbg = chip8->debugger;
+        printf("stopped: %s\n", dbg->reason);
+        print_registers(chip8);
+
+        char line[128];
+        for (;;) {
+                printf("(chip8) ");
+                fflush(stdout);
+                if (!fgets(line, sizeof(line), stdin)) {
+                        chip8->state = QUIT;
+                        return;
+                }
+
+                char* args = &line[1];
+                switch (line[0]) {
+                        case 'b': add_breakpoint(chip8, dbg, args); break;
+                        case 'w': add_watchpoint(chip8, dbg, args); break;
+                        case 'd': delete_point(chip8, dbg, args); break;
+                        case 'l': print_points(dbg); break;
+                        case 'r': print_registers(chip8); break;
+                        case 'x': dump_ram(chip8, args); break;
+                        case 's': {
+                                const u32 steps = strtoul(args, NULL, 0);
+                                for (u32 i = 0; i < (steps ? steps : 1); i++) {
+                                        emulate_instruction(chip8);
+                                        if (dbg->stop_pc != NO_RESUME) {
+                                                break;
+                                        }
+                                }
+                                // A watchpoint hit while stepping stops here.
+                                if (dbg->stop_pc != NO_RESUME) {
+                                        const u16 pc = dbg->stop_pc;
+                                        dbg->stop_pc = NO_RESUME;
+                                        clear_trap(chip8, pc);
+                                        printf("stopped: %s\n", dbg->reason);
+                                }
+                                print_registers(chip8);
+                                break;
+                        }
+                        case 'f': {
+                                const u32 frames = strtoul(args, NULL, 0);
+                                resume(chip8, dbg);
+                                dbg->frames_left = frames ? frames : 1;
+                                return;
+                        }
+                        case 'c': resume(chip8, dbg); return;
+                        case 'q': chip8->state = QUIT; return;
+                        default:
+                                printf("b <addr> [if <Vx|I> <op> <value>]  "
+                                       "breakpoint\n"
+                                       "w <addr> [len]  watch ram writes\n"
+                                       "d <bN|wN>       delete\n"
+                                       "l               list\n"
+                                       "s [n]           step n instructions\n"
+                                       "f [n]           run n frames\n"
+                                       "c               continue\n"
+                                       "r               registers\n"
+                                       "x [addr] [len]  dump ram, defaults "
+                                       "to I\n"
+                                       "q               quit\n");
+                                break;
+                }
+        }
+}
+
+#endif
@@ -0,0 +1,215 @@
+#ifndef FRAMETIME_H
+#define FRAMETIME_H
+
+#include <raylib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "types.h"
+
+// Host frame phase timing. Every phase of the frontend loop is stamped with
+// the monotonic clock and recorded into a log-linear (HDR style) histogram:
+// values below HIST_SUB_COUNT ns are exact, above that every power of two is
+// split into HIST_SUB_COUNT buckets, so any percentile is off by < 1/16.
+
+#define HIST_SUB_BITS  4
+#define HIST_SUB_COUNT (1u << HIST_SUB_BITS)
+#define HIST_BUCKETS   ((64 - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
+#define NS_PER_SECOND  1000000000ull
+#define NS_PER_MS      1e6
+#define NS_PER_US      1e3
+
+typedef enum {
+        PHASE_INPUT,
+        PHASE_CPU,
+        PHASE_TIMERS,
+        PHASE_RENDER,  // Drawing plus the EndDrawing vsync wait
+        PHASE_FRAME,   // Start to start of consecutive frames
+        PHASE_JITTER,  // |frame - 1/fps|
+        NUM_OF_PHASES,
+} frame_phase_t;
+
+const char* phase_lookup[NUM_OF_PHASES] = {
+    [PHASE_INPUT]  = "input",
+    [PHASE_CPU]    = "cpu",
+    [PHASE_TIMERS] = "timers",
+    [PHASE_RENDER] = "render",
+    [PHASE_FRAME]  = "frame",
+    [PHASE_JITTER] = "jitter",
+};
+
+typedef struct {
+        u64 count;
+        u64 sum;
+        u64 max;
+        u32 buckets[HIST_BUCKETS];
+} histogram_t;
+
+typedef struct {
+        histogram_t phases[NUM_OF_PHASES];
+        u64         target_ns;    // Expected frame length
+        u64         frame_start;  // 0 when the last frame was skipped
+        u64         phase_start;
+        bool        overlay;
+} frame_timer_t;
+
+u64 monotonic_ns(void) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return ((u64)now.tv_sec * NS_PER_SECOND) + (u64)now.tv_nsec;
+}
+
+u32 hist_bucket(const u64 ns) {
+        if (ns < HIST_SUB_COUNT) {
+                return (u32)ns;
+        }
+        const u32 msb   = 63 - __builtin_clzll(ns);
+        const u32 shift = msb - HIST_SUB_BITS;
+        return ((shift + 1) * HIST_SUB_COUNT) +
+               (u32)((ns >> shift) - HIST_SUB_COUNT);
+}
+
+// Highest value that lands in bucket, what percentiles report.
+u64 hist_bucket_max(const u32 bucket) {
+        if (bucket < HIST_SUB_COUNT) {
+                return bucket;
+        }
+        const u32 shift = (bucket / HIST_SUB_COUNT) - 1;
+        const u64 low   = (u64)((bucket % HIST_SUB_COUNT) + HIST_SUB_COUNT)
+                        << shift;
+        return low + ((1ull << shift) - 1);
+}
+
+void hist_record(histogram_t* hist, const u64 ns) {
+        hist->buckets[hist_bucket(ns)]++;
+        hist->count++;
+        hist->sum += ns;
+        if (ns > hist->max) {
+                hist->max = ns;
+        }
+}
+
+// p in [0, 1], clamped to the exact max so p100 never overshoots it.
+u64 hist_percentile(const histogram_t* hist, const double p) {
+        if (hist->count == 0) {
+                return 0;
+        }
+        const double exact = p * (double)hist->count;
+        u64          rank  = (u64)exact;
+        rank += rank < exact || rank == 0;  // ceil, and at least one sample
+
+        u64 seen = 0;
+        for (u32 bucket = 0; bucket < HIST_BUCKETS; bucket++) {
+                seen += hist->buckets[bucket];
+                if (seen >= rank) {
+                        const u64 value = hist_bucket_max(bucket);
+                        return value < hist->max ? value : hist->max;
+                }
+        }
+        return hist->max;
+}
+
+void init_frame_timer(frame_timer_t* timer, const u32 fps) {
+        memset(timer, 0, sizeof(*timer));
+        timer->target_ns = NS_PER_SECOND / fps;
+}
+
+// Starts a frame, the time since the previous start feeds frame and jitter.
+void frame_timer_begin(frame_timer_t* timer) {
+        const u64 now = monotonic_ns();
+        if (timer->frame_start) {
+                const u64 frame  = now - timer->frame_start;
+                const u64 target = timer->target_ns;
+                hist_record(&timer->phases[PHASE_FRAME], frame);
+                hist_record(&timer->phases[PHASE_JITTER],
+                            frame > target ? frame - target : target - frame);
+        }
+        timer->frame_start = now;
+        timer->phase_start = now;
+}
+
+// Ends `phase`, the next one starts now.
+void frame_timer_mark(frame_timer_t* timer, const frame_phase_t phase) {
+        const u64 now = monotonic_ns();
+        hist_record(&timer->phases[phase], now - timer->phase_start);
+        timer->phase_start = now;
+}
+
+// Frames that don't run (paused, debugger prompt) don't count as a long frame.
+void frame_timer_skip(frame_timer_t* timer) {
+        timer->frame_start = 0;
+}
+
+// Draws one line per phase, call between BeginDrawing and EndDrawing.
+void draw_frame_timer(const frame_timer_t* timer,
+                      const int            font_size,
+                      const Color          color) {
+        char line[96];
+        for (u32 phase = 0; phase < NUM_OF_PHASES; phase++) {
+                const histogram_t* hist = &timer->phases[phase];
+                snprintf(line,
+                         sizeof(line),
+                         "%-6s p50 %7.3f  p99 %7.3f  max %7.3f ms",
+                         phase_lookup[phase],
+                         hist_percentile(hist, 0.50) / NS_PER_MS,
+                         hist_percentile(hist, 0.99) / NS_PER_MS,
+                         hist->max / NS_PER_MS);
+                DrawText(line,
+                         font_size / 2,
+                         (int)(font_size * (phase + 0.5)),
+                         font_size,
+                         color);
+        }
+}
+
+// Writes every histogram as JSON, only non empty buckets are listed as
+// [highest ns, count] pairs.
+bool export_frame_timer(const frame_timer_t* timer, const char path[]) {
+        FILE* out = fopen(path, "w");
+        if (!out) {
+                TraceLog(LOG_ERROR, "Couldn't open %s for frame stats", path);
+                return false;
+        }
+
+        fprintf(out, "{\n  \"target_frame_ns\": %llu,\n  \"phases\": {\n",
+                (unsigned long long)timer->target_ns);
+        for (u32 phase = 0; phase < NUM_OF_PHASES; phase++) {
+                const histogram_t* hist = &timer->phases[phase];
+                fprintf(out,
+                        "    \"%s\": {\"count\": %llu, \"mean_us\": %.3f, "
+                        "\"p50_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f, "
+                        "\"buckets\": [",
+                        phase_lookup[phase],
+                        (unsigned long long)hist->count,
+                        hist->count ? hist->sum / NS_PER_US / hist->count : 0.0,
+                        hist_percentile(hist, 0.50) / NS_PER_US,
+                        hist_percentile(hist, 0.99) / NS_PER_US,
+                        hist->max / NS_PER_US);
+
+                bool first = true;
+                for (u32 bucket = 0; bucket < HIST_BUCKETS; bucket++) {
+                        if (!hist->buckets[bucket]) {
+                                continue;
+                        }
+                        fprintf(out,
+                                "%s[%llu, %u]",
+                                first ? "" : ", ",
+                                (unsigned long long)hist_bucket_max(bucket),
+                                hist->buckets[bucket]);
+                        first = false;
+                }
+                fprintf(out, "]}%s\n", phase + 1 < NUM_OF_PHASES ? "," : "");
+        }
+        fprintf(out, "  }\n}\n");
+
+        const bool ok = !ferror(out);
+        fclose(out);
+        if (!ok) {
+                TraceLog(LOG_ERROR, "Couldn't write frame stats to %s", path);
+        }
+        return ok;
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <sys/types.h>
+
+// Wire protocol spoken by chip8-server over its Unix-domain socket.
+// Everything is in host byte order since both ends live on the same machine.
+//
+// Client -> server: fixed size stream_input_msg_t messages.
+//   STREAM_MSG_ATTACH: start viewing `session`, a full frame is sent next.
+//   STREAM_MSG_KEYS:   replace the session keypad, bit N = key N down.
+//
+// Server -> client: one stream_delta_header_t per frame that changed, followed
+// by one u_int64_t per set bit in `rows` (lowest row first). Each row holds the
+// 64 pixels of that line, most significant bit is the leftmost pixel.
+
+#define STREAM_MSG_ATTACH 0x01
+#define STREAM_MSG_KEYS   0x02
+
+#define STREAM_ROW_BYTES  8
+#define STREAM_MAX_DELTA \
+        (sizeof(stream_delta_header_t) + (32 * STREAM_ROW_BYTES))
+
+typedef struct {
+        u_int8_t  type;
+        u_int8_t  session;
+        u_int16_t keys;
+} stream_input_msg_t;
+
+typedef struct {
+        u_int32_t frame;  // Session frame the rows were taken from
+        u_int32_t rows;   // Bit N set when row N follows
+} stream_delta_header_t;
+
+#endif
@@ -1,3 +1,6 @@
+#ifndef TYPES_H
+#define TYPES_H
+
 #include <raylib.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -18,11 +21,14 @@
 #define INSTRUCTIONS_PER_FRAME 10
 
 #define DISLPAY_SIZE   64 * 32
-#define STACK_SIZE     12
+#define STACK_SIZE     16  // Power of two so the stack index wraps with a mask
+#define STACK_MASK     (STACK_SIZE - 1)
 #define REGISTERS_SIZE 16
 #define VF_REGISTER    0xF
 #define KEYPAD_SIZE    16
+#define KEYPAD_MASK    (KEYPAD_SIZE - 1)
 #define SPRITE_WIDTH   8
+#define ALL_ROWS_DIRTY 0xFFFFFFFFu  // One bit per CHIP_HEIGHT row
 
 #define FONT_CHAR_SIZE     5
 #define FONT_START_ADDRESS 0
@@ -30,6 +36,14 @@
 #define Byte(a)      (a * 1)
 #define Kilobytes(a) (a * Byte(1024))
 
+#define RAM_SIZE    Kilobytes(4)
+#define RAM_MASK    (RAM_SIZE - 1)
+#define ENTRY_POINT 0x200
+#define PAGE_SHIFT  8
+#define PAGE_SIZE   (1 << PAGE_SHIFT)
+#define PAGE_MASK   (PAGE_SIZE - 1)
+#define PAGE_COUNT  (RAM_SIZE / PAGE_SIZE)
+
 #define CLEAR_OPCODE  0x00E0
 #define RETURN_OPCODE 0x00EE
 
@@ -87,6 +101,10 @@ typedef struct {
 
         Color fg_color;  // RGBA8888
         Color bg_color;  // RGBA8888
+
+        bool        debug;        // Start stopped in the stdin debugger
+        bool        fuse;         // Run hot sequences through fused handlers
+        const char* stats_path;  // Frame phase histograms as JSON at exit
 } config_t;
 
 // Emulator State
@@ -195,13 +213,48 @@ typedef enum {
         INST_F_COUNT
 } instruction_F_id_t;
 
-// Chip8
+// Opcode sequences run by a single handler, see fuse_program.
+typedef enum {
+        FUSION_NONE,
+        FUSION_ANNN_DXYN,       // Point I at a sprite and draw it
+        FUSION_6XNN_6XNN,       // Two register loads
+        FUSION_7XNN_3XNN_1NNN,  // Counting loop
+        FUSION_FX29_DXY5,       // Draw a font digit
+        FUSION_TRAP,            // Swapped in by a debugger, see fused_trap
+        FUSION_COUNT,
+} fusion_id_t;
+
+const char* fusion_lookup[FUSION_COUNT] = {
+    [FUSION_NONE]           = "NONE",
+    [FUSION_ANNN_DXYN]      = "ANNN+DXYN",
+    [FUSION_6XNN_6XNN]      = "6XNN+6XNN",
+    [FUSION_7XNN_3XNN_1NNN] = "7XNN+3XNN+1NNN",
+    [FUSION_FX29_DXY5]      = "FX29+DXY5",
+    [FUSION_TRAP]           = "TRAP",
+};
+
+// Font and rom as loaded, shared read-only by every machine running them.
 typedef struct {
+        u8          ram[RAM_SIZE];
+        u8          fusion[RAM_SIZE];  // fusion_id_t starting at each addr
+        const char* rom_name;
+        u16         rom_size;  // Bytes loaded at ENTRY_POINT
+        bool        fused;     // fusion[] filled in, see enable_fusion
+        u32         refs;  // Machines using the image plus the loader's ref
+} chip8_image_t;
+
+// Chip8
+typedef struct chip8 {
         emulator_state_t state;
-        u8               ram[Kilobytes(4)];
-        bool             display[DISLPAY_SIZE];
+        chip8_image_t*   image;
+        u8*              pages[PAGE_COUNT];         // Shared until written
+        u8*              fusion_pages[PAGE_COUNT];  // Follow pages[] sharing
+        u16              private_pages;  // Bit N set once page N was copied
+        u16              watched_pages;  // Writes here go through on_write
+        u16              writable_pages;  // private_pages & ~watched_pages
+        u64              display[CHIP_HEIGHT];  // MSB is the leftmost pixel
         u16              stack[STACK_SIZE];
-        u16*             stack_ptr;
+        u8               sp;  // Next free slot, wraps instead of overflowing
         u8               V[REGISTERS_SIZE];  // Register V0 to VF
         u16              I;                  // Index register
         u16              PC;                 // Program Counter
@@ -210,9 +263,88 @@ typedef struct {
         bool        keypad[KEYPAD_SIZE];  // Hex keypad 0-F
         const char* rom_name;             // Name of the file emulating
         instruction_t inst;               // current instruction
+        u32           dirty_rows;  // Bit N set when display row N changed
+        u64           fusion_hits[FUSION_COUNT];
+        bool          fused;  // Dispatch through the fusion table
+
+        // Debugger hooks, NULL unless one is attached. on_trap runs when PC
+        // reaches a FUSION_TRAP entry and pauses the machine by returning
+        // true, on_write sees every write landing on a watched page.
+        bool (*on_trap)(struct chip8* chip8);
+        void (*on_write)(struct chip8* chip8, u16 addr);
+        void* debugger;
 } chip8_t;
 
 typedef void (*instruction_handler_t)(chip8_t*);
+typedef u32 (*fusion_handler_t)(chip8_t*);  // Returns instructions executed
+
+#define MAX_FUSION_BYTES 6
+
+u8 read_ram(const chip8_t* chip8, const u16 addr) {
+        const u16 masked = addr & RAM_MASK;
+        return chip8->pages[masked >> PAGE_SHIFT][masked & PAGE_MASK];
+}
+
+// Gives the machine its own copy of a page, and of the page's fusion entries,
+// before its first write there.
+void make_page_private(chip8_t* chip8, const u8 page) {
+        u8* copy = malloc(2 * PAGE_SIZE);
+        if (!copy) {
+                TraceLog(LOG_ERROR, "Out of memory copying page %u", page);
+                chip8->state = QUIT;
+                return;
+        }
+
+        memcpy(copy, chip8->pages[page], PAGE_SIZE);
+        memcpy(copy + PAGE_SIZE, chip8->fusion_pages[page], PAGE_SIZE);
+        chip8->pages[page]        = copy;
+        chip8->fusion_pages[page] = copy + PAGE_SIZE;
+        chip8->private_pages |= 1u << page;
+        chip8->writable_pages = chip8->private_pages & ~chip8->watched_pages;
+}
+
+// Undoes make_page_private once the page matches the image again.
+void make_page_shared(chip8_t* chip8, const u8 page) {
+        free(chip8->pages[page]);
+        chip8->pages[page]        = &chip8->image->ram[page * PAGE_SIZE];
+        chip8->fusion_pages[page] = &chip8->image->fusion[page * PAGE_SIZE];
+        chip8->private_pages &= ~(1u << page);
+        chip8->writable_pages = chip8->private_pages & ~chip8->watched_pages;
+}
+
+// Drops fused sequences covering a page offset so rewritten code is decoded
+// again one instruction at a time. Fused sequences never cross pages, and
+// debugger traps stay in place.
+void invalidate_fusions(chip8_t* chip8, const u8 page, const i32 offset) {
+        u8* fusion = chip8->fusion_pages[page];
+        for (i32 i = offset; i >= 0 && i > offset - MAX_FUSION_BYTES; i--) {
+                if (fusion[i] != FUSION_TRAP) {
+                        fusion[i] = FUSION_NONE;
+                }
+        }
+}
+
+void write_ram(chip8_t* chip8, const u16 addr, const u8 value) {
+        const u16 masked = addr & RAM_MASK;
+        const u8  page   = masked >> PAGE_SHIFT;
+        const i32 offset = masked & PAGE_MASK;
+
+        // Shared and watched pages take the slow path, plain writes to
+        // private pages cost a single mask test.
+        const bool fault = !(chip8->writable_pages & (1u << page));
+        if (fault && !(chip8->private_pages & (1u << page))) {
+                make_page_private(chip8, page);
+                if (chip8->state == QUIT) {
+                        return;
+                }
+        }
+        chip8->pages[page][offset] = value;
+        invalidate_fusions(chip8, page, offset);
+
+        if (fault && (chip8->watched_pages & (1u << page)) && chip8->on_write) {
+                chip8->on_write(chip8, masked);
+        }
+}
 
 void inst_0NNN(chip8_t* chip8) {
         (void)chip8;  // Do nothing
@@ -221,11 +353,12 @@ void inst_0NNN(chip8_t* chip8) {
 void inst_00E0(chip8_t* chip8) {
         DEBUG_LOG("Clear screen\n");
         memset(chip8->display, 0, sizeof(chip8->display));
+        chip8->dirty_rows = ALL_ROWS_DIRTY;
 }
 
 void inst_00EE(chip8_t* chip8) {
-        chip8->stack_ptr--;
-        chip8->PC = *chip8->stack_ptr;
+        chip8->sp = (chip8->sp - 1) & STACK_MASK;
+        chip8->PC = chip8->stack[chip8->sp];
 }
 
 void inst_1NNN(chip8_t* chip8) {
@@ -238,8 +371,8 @@ void inst_2NNN(chip8_t* chip8) {
                   chip8->inst.addr.NNN,
                   chip8->PC);
 
-        *chip8->stack_ptr = chip8->PC;
-        chip8->stack_ptr++;
+        chip8->stack[chip8->sp] = chip8->PC;
+        chip8->sp               = (chip8->sp + 1) & STACK_MASK;
         chip8->PC = chip8->inst.addr.NNN;
 }
 
@@ -281,24 +414,20 @@ void inst_DXYN(chip8_t* chip8) {
 
         chip8->V[VF_REGISTER] = 0;
 
-        for (u8 row = 0; row < nibble; row++) {
-                const u8 sprite = chip8->ram[chip8->I + row];
+        // Sprites clip at the right edge, whatever is shifted past column 63
+        // falls off the row.
+        for (u8 row = 0; row < nibble && (dyc + row) < CHIP_HEIGHT; row++) {
+                const u8  sprite = read_ram(chip8, chip8->I + row);
+                const u64 bits =
+                    ((u64)sprite << (CHIP_WIDTH - SPRITE_WIDTH)) >> dxc;
+                u64* line = &chip8->display[dyc + row];
 
-                for (u8 col = 0; col < SPRITE_WIDTH; col++) {
-                        const u8 sprite_pixel = (sprite >> (7 - col)) & 0x1;
-                        if ((dyc + row) >= CHIP_HEIGHT ||
-                            (dxc + col) >= CHIP_WIDTH) {
-                                break;
-                        }
-                        const u16 display_index =
-                            ((dyc + row) * CHIP_WIDTH) + (dxc + col);
-
-                        if (sprite_pixel) {
-                                if (chip8->display[display_index]) {
-                                        chip8->V[VF_REGISTER] = 1;
-                                }
-                                chip8->display[display_index] ^= 1;
-                        }
+                if (*line & bits) {
+                        chip8->V[VF_REGISTER] = 1;
+                }
+                *line ^= bits;
+                if (bits) {
+                        chip8->dirty_rows |= 1u << (dyc + row);
                 }
         }
 
@@ -419,14 +548,14 @@ void inst_CXNN(chip8_t* chip8) {
 
 void inst_EX9E(chip8_t* chip8) {
         const u8 Vx = chip8->inst.reg_byte.Vx;
-        if (chip8->keypad[chip8->V[Vx]]) {
+        if (chip8->keypad[chip8->V[Vx] & KEYPAD_MASK]) {
                 chip8->PC += 2;
         }
 }
 
 void inst_EXA1(chip8_t* chip8) {
         const u8 Vx = chip8->inst.reg_byte.Vx;
-        if (!chip8->keypad[chip8->V[Vx]]) {
+        if (!chip8->keypad[chip8->V[Vx] & KEYPAD_MASK]) {
                 chip8->PC += 2;
         }
 }
@@ -463,22 +592,22 @@ void inst_FX29(chip8_t* chip8) {
 
 void inst_FX33(chip8_t* chip8) {
         const u8 val             = chip8->V[chip8->inst.reg_byte.Vx];
-        chip8->ram[chip8->I]     = val / HUNDREDS;
-        chip8->ram[chip8->I + 1] = (val / TENS) % TENS;
-        chip8->ram[chip8->I + 2] = val % TENS;
+        write_ram(chip8, chip8->I, val / HUNDREDS);
+        write_ram(chip8, chip8->I + 1, (val / TENS) % TENS);
+        write_ram(chip8, chip8->I + 2, val % TENS);
 }
 
 void inst_FX55(chip8_t* chip8) {
         const u8 Vx = chip8->inst.reg_byte.Vx;
         for (u8 i = 0; i <= Vx; ++i) {
-                chip8->ram[chip8->I + i] = chip8->V[i];
+                write_ram(chip8, chip8->I + i, chip8->V[i]);
         }
 }
 
 void inst_FX65(chip8_t* chip8) {
         const u8 Vx = chip8->inst.reg_byte.Vx;
         for (u8 i = 0; i <= Vx; ++i) {
-                chip8->V[i] = chip8->ram[chip8->I + i];
+                chip8->V[i] = read_ram(chip8, chip8->I + i);
         }
 }
 
@@ -590,3 +719,400 @@ static const instruction_handler_t instruction_table[INST_COUNT] = {
     [INST_E] = dispatch_E_family,
     [INST_F] = dispatch_F_family,
 };
+
+u16 fetch_opcode(const chip8_t* chip8, const u16 addr) {
+        return (read_ram(chip8, addr) << 8) | read_ram(chip8, addr + 1);
+}
+
+void emulate_instruction(chip8_t* chip8) {
+        const u8 byte      = 8;
+        const u8 mask      = 0xF;
+        chip8->inst.opcode = fetch_opcode(chip8, chip8->PC);
+        chip8->PC += 2;
+
+        DEBUG_LOG(
+            "PC: 0x%03X | Opcode: 0x%04X | ", chip8->PC, chip8->inst.opcode);
+
+        u8 op_high_nibble = (chip8->inst.opcode >> (byte + 4)) & mask;
+        instruction_handler_t handler = instruction_table[op_high_nibble];
+        if (!handler) {
+                DEBUG_LOG("\n");
+                TraceLog(LOG_ERROR,
+                         "Unimplemented instruction: 0x%04X",
+                         chip8->inst.opcode);
+
+#ifndef DEBUG
+                chip8->state = QUIT;
+#endif
+
+                return;
+        }
+        handler(chip8);
+}
+
+u32 fused_ANNN_DXYN(chip8_t* chip8) {
+        const u16 pc       = chip8->PC;
+        chip8->I           = fetch_opcode(chip8, pc) & 0x0FFF;
+        chip8->inst.opcode = fetch_opcode(chip8, pc + 2);
+        chip8->PC          = pc + 4;
+        inst_DXYN(chip8);
+        return 2;
+}
+
+u32 fused_6XNN_6XNN(chip8_t* chip8) {
+        const u16 pc     = chip8->PC;
+        const u16 first  = fetch_opcode(chip8, pc);
+        const u16 second = fetch_opcode(chip8, pc + 2);
+        chip8->V[(first >> 8) & 0xF]  = first & 0xFF;
+        chip8->V[(second >> 8) & 0xF] = second & 0xFF;
+        chip8->inst.opcode            = second;
+        chip8->PC                     = pc + 4;
+        return 2;
+}
+
+u32 fused_7XNN_3XNN_1NNN(chip8_t* chip8) {
+        const u16 pc      = chip8->PC;
+        const u16 add     = fetch_opcode(chip8, pc);
+        const u16 compare = fetch_opcode(chip8, pc + 2);
+        chip8->V[(add >> 8) & 0xF] += add & 0xFF;
+
+        if (chip8->V[(compare >> 8) & 0xF] == (compare & 0xFF)) {
+                chip8->inst.opcode = compare;
+                chip8->PC          = pc + 6;
+                return 2;
+        }
+
+        chip8->inst.opcode = fetch_opcode(chip8, pc + 4);
+        chip8->PC          = chip8->inst.addr.NNN;
+        return 3;
+}
+
+u32 fused_FX29_DXY5(chip8_t* chip8) {
+        const u16 pc       = chip8->PC;
+        const u8  Vx       = (fetch_opcode(chip8, pc) >> 8) & 0xF;
+        chip8->I           = chip8->V[Vx] * FONT_CHAR_SIZE;
+        chip8->inst.opcode = fetch_opcode(chip8, pc + 2);
+        chip8->PC          = pc + 4;
+        inst_DXYN(chip8);
+        return 2;
+}
+
+// Runs a single instruction unless the debugger decides to stop at it, the
+// run loop treats 0 instructions executed as a request to stop.
+u32 fused_trap(chip8_t* chip8) {
+        if (chip8->on_trap && chip8->on_trap(chip8)) {
+                chip8->state = PAUSED;
+                return 0;
+        }
+        emulate_instruction(chip8);
+        return 1;
+}
+
+static const fusion_handler_t fusion_table[FUSION_COUNT] = {
+    [FUSION_ANNN_DXYN]      = fused_ANNN_DXYN,
+    [FUSION_6XNN_6XNN]      = fused_6XNN_6XNN,
+    [FUSION_7XNN_3XNN_1NNN] = fused_7XNN_3XNN_1NNN,
+    [FUSION_FX29_DXY5]      = fused_FX29_DXY5,
+    [FUSION_TRAP]           = fused_trap,
+};
+
+// Longest path through each fused handler, in instructions.
+static const u8 fusion_length[FUSION_COUNT] = {
+    [FUSION_ANNN_DXYN]      = 2,
+    [FUSION_6XNN_6XNN]      = 2,
+    [FUSION_7XNN_3XNN_1NNN] = 3,
+    [FUSION_FX29_DXY5]      = 2,
+    [FUSION_TRAP]           = 1,
+};
+
+// Fusion starting at ram[0], the caller makes sure all MAX_FUSION_BYTES of it
+// are in the same page.
+fusion_id_t match_fusion_bytes(const u8 ram[]) {
+        const u16 first  = (ram[0] << 8) | ram[1];
+        const u16 second = (ram[2] << 8) | ram[3];
+        const u16 third  = (ram[4] << 8) | ram[5];
+
+        if ((first >> 12) == INST_A && (second >> 12) == INST_D) {
+                return FUSION_ANNN_DXYN;
+        }
+        if ((first >> 12) == INST_6 && (second >> 12) == INST_6) {
+                return FUSION_6XNN_6XNN;
+        }
+        if ((first >> 12) == INST_7 && (second >> 12) == INST_3 &&
+            (third >> 12) == INST_1) {
+                return FUSION_7XNN_3XNN_1NNN;
+        }
+        if ((first & 0xF0FF) == (0xF000 | OPCODE_FX29) &&
+            (second & 0xF00F) == (0xD000 | FONT_CHAR_SIZE)) {
+                return FUSION_FX29_DXY5;
+        }
+        return FUSION_NONE;
+}
+
+fusion_id_t match_fusion(const chip8_image_t* image, const u16 addr) {
+        return match_fusion_bytes(&image->ram[addr]);
+}
+
+// Fills the fusion entries of [start, end), the caller leaves the ones past
+// end FUSION_NONE. Sequences don't cross pages, so an address only reads its
+// own page and a write only ever invalidates entries on its own page. Debug
+// builds keep one log line per instruction, so they don't fuse.
+void fuse_range(chip8_image_t* image, const u32 start, const u32 end) {
+#ifndef DEBUG
+        for (u32 addr = start; addr < end; addr++) {
+                const bool fits =
+                    (addr & PAGE_MASK) + MAX_FUSION_BYTES <= PAGE_SIZE;
+                image->fusion[addr] =
+                    fits ? match_fusion(image, addr) : FUSION_NONE;
+        }
+#else
+        memset(&image->fusion[start], FUSION_NONE, end - start);
+#endif
+}
+
+// Marks every address of a loaded image where a fusable sequence starts.
+// Data gets scanned too, which is harmless since the table is only consulted
+// at PC.
+void fuse_program(chip8_image_t* image) {
+        fuse_range(image, 0, sizeof(image->ram));
+}
+
+void release_chip8_image(chip8_image_t* image) {
+        if (--image->refs == 0) {
+                free(image);
+        }
+}
+
+const u8 chip8_font[] = {
+    0xF0, 0x90, 0x90, 0x90, 0xF0,  // 0
+    0x20, 0x60, 0x20, 0x20, 0x70,  // 1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0,  // 2
+    0xF0, 0x10, 0xF0, 0x10, 0xF0,  // 3
+    0x90, 0x90, 0xF0, 0x10, 0x10,  // 4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0,  // 5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0,  // 6
+    0xF0, 0x10, 0x20, 0x40, 0x40,  // 7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0,  // 8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0,  // 9
+    0xF0, 0x90, 0xF0, 0x90, 0x90,  // A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0,  // B
+    0xF0, 0x80, 0x80, 0x80, 0xF0,  // C
+    0xE0, 0x90, 0x90, 0x90, 0xE0,  // D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0,  // E
+    0xF0, 0x80, 0xF0, 0x80, 0x80   // F
+};
+
+// Loads font and rom once, machines then share it via init_chip8_from_image.
+// The caller owns one reference.
+chip8_image_t* load_chip8_image(const char rom_name[]) {
+        const u32 entry_point = ENTRY_POINT;
+
+        chip8_image_t* image = calloc(1, sizeof(*image));
+        if (!image) {
+                TraceLog(LOG_ERROR, "Couldn't allocate image for %s", rom_name);
+                return NULL;
+        }
+        image->refs     = 1;
+        image->rom_name = rom_name;
+        memcpy(&image->ram[0], chip8_font, sizeof(chip8_font));
+
+        FILE* rom = fopen(rom_name, "rb");
+        if (!rom) {
+                TraceLog(LOG_ERROR,
+                         "Rom file %s is invalid or does not exist...",
+                         rom_name);
+                free(image);
+                return NULL;
+        }
+        if (fseek(rom, 0, SEEK_END) != 0) {
+                TraceLog(LOG_ERROR, "Couldn't move cursor to end of file\n");
+                fclose(rom);
+                free(image);
+                return NULL;
+        };
+
+        const size_t rom_size = ftell(rom);
+        const size_t max_size = sizeof(image->ram) - entry_point;
+        if (fseek(rom, 0, SEEK_SET) != 0) {
+                TraceLog(LOG_ERROR,
+                         "Couldn't move cursor to beginning of file\n");
+                fclose(rom);
+                free(image);
+                return NULL;
+        }
+
+        if (rom_size > max_size) {
+                TraceLog(LOG_ERROR,
+                         "Rom file %s is too big for this chip8, max size: %zu",
+                         rom_name,
+                         max_size);
+                fclose(rom);
+                free(image);
+                return NULL;
+        }
+
+        if (fread(&image->ram[entry_point], rom_size, 1, rom) != 1) {
+                TraceLog(
+                    LOG_ERROR, "Couldn't read rom: %s, into ram\n", rom_name);
+                fclose(rom);
+                free(image);
+                return NULL;
+        }
+        fclose(rom);
+        image->rom_size = rom_size;
+        return image;
+}
+
+// Reloads an image nothing else shares from rom bytes already in memory, so
+// harnesses can feed one input after another without reallocating it.
+bool load_chip8_rom(chip8_image_t* image, const u8 rom[], const size_t size) {
+        if (image->refs > 1 || size > sizeof(image->ram) - ENTRY_POINT) {
+                return false;
+        }
+
+        // Past its rom an image is still zeroed, only the tail of a longer
+        // previous rom needs clearing.
+        const u32 end     = ENTRY_POINT + size;
+        const u32 old_end = ENTRY_POINT + image->rom_size;
+        if (old_end > end) {
+                memset(&image->ram[end], 0, old_end - end);
+                memset(&image->fusion[end], FUSION_NONE, old_end - end);
+        }
+        const bool first =
+            memcmp(image->ram, chip8_font, sizeof(chip8_font)) != 0;
+        if (first) {
+                memcpy(&image->ram[0], chip8_font, sizeof(chip8_font));
+        }
+        memcpy(&image->ram[ENTRY_POINT], rom, size);
+        image->rom_size = size;
+
+        // A fused image stays fused. The pages below the rom only change on
+        // the first load, and zeroed ram never fuses.
+        if (image->fused) {
+                fuse_range(image, first ? 0 : ENTRY_POINT, end);
+        }
+        return true;
+}
+
+// Powers on a machine sharing every page of image. The machine must be zeroed
+// or released.
+void init_chip8_from_image(chip8_t* chip8, chip8_image_t* image) {
+        image->refs++;
+        chip8->image = image;
+        for (u8 page = 0; page < PAGE_COUNT; page++) {
+                chip8->pages[page]        = &image->ram[page * PAGE_SIZE];
+                chip8->fusion_pages[page] = &image->fusion[page * PAGE_SIZE];
+        }
+        chip8->private_pages  = 0;
+        chip8->watched_pages  = 0;
+        chip8->writable_pages = 0;
+        memset(chip8->fusion_hits, 0, sizeof(chip8->fusion_hits));
+
+        chip8->state    = RUNNING;
+        chip8->sp       = 0;
+        chip8->PC       = ENTRY_POINT;
+        chip8->rom_name = image->rom_name;
+}
+
+bool init_chip8(chip8_t* chip8, const char rom_name[]) {
+        chip8_image_t* image = load_chip8_image(rom_name);
+        if (!image) {
+                return false;
+        }
+
+        init_chip8_from_image(chip8, image);
+        release_chip8_image(image);
+        return true;
+}
+
+// Frees the machine's private pages and drops its image reference.
+void release_chip8(chip8_t* chip8) {
+        for (u8 page = 0; page < PAGE_COUNT; page++) {
+                if (chip8->private_pages & (1u << page)) {
+                        free(chip8->pages[page]);
+                }
+        }
+        chip8->private_pages = 0;
+
+        if (chip8->image) {
+                release_chip8_image(chip8->image);
+                chip8->image = NULL;
+        }
+}
+
+// Fused version of run_instructions, a fused sequence is only taken when all
+// of it fits so frame boundaries land where they would unfused.
+void run_fused(chip8_t* chip8, const u32 count) {
+        u32 done = 0;
+        while (done < count) {
+                const u16         pc = chip8->PC & RAM_MASK;
+                const fusion_id_t fusion =
+                    chip8->fusion_pages[pc >> PAGE_SHIFT][pc & PAGE_MASK];
+                if (fusion != FUSION_NONE &&
+                    done + fusion_length[fusion] <= count) {
+                        const u32 ran = fusion_table[fusion](chip8);
+                        if (ran == 0) {
+                                break;
+                        }
+                        done += ran;
+                        chip8->fusion_hits[fusion]++;
+                        continue;
+                }
+
+                emulate_instruction(chip8);
+                done++;
+        }
+}
+
+// Switches a machine to fused dispatch. The image is fused on first use so
+// machines that never ask for it don't pay for the scan.
+void enable_fusion(chip8_t* chip8) {
+        if (!chip8->image->fused) {
+                fuse_program(chip8->image);
+                chip8->image->fused = true;
+        }
+        chip8->fused = true;
+}
+
+// Runs exactly `count` instructions. The table lookup costs about what a
+// fused dispatch saves, so only machines that asked for fusion or carry
+// debugger traps go through it.
+void run_instructions(chip8_t* chip8, const u32 count) {
+        if (chip8->fused) {
+                run_fused(chip8, count);
+                return;
+        }
+        for (u32 i = 0; i < count; i++) {
+                emulate_instruction(chip8);
+        }
+}
+
+// Runs one 60hz frame worth of instructions for frontends without a clock of
+// their own, ticking the timers once.
+void emulate_frame(chip8_t* chip8) {
+        run_instructions(chip8, INSTRUCTIONS_PER_FRAME);
+
+        if (chip8->delay_timer > 0) chip8->delay_timer--;
+        if (chip8->sound_timer > 0) chip8->sound_timer--;
+}
+
+// Copies a whole machine into a zeroed or released one. The copy shares the
+// image and gets its own copies of src's private pages.
+void copy_chip8(chip8_t* dst, const chip8_t* src) {
+        memcpy(dst, src, sizeof(*dst));
+        dst->image->refs++;
+
+        dst->on_trap        = NULL;
+        dst->on_write       = NULL;
+        dst->debugger       = NULL;
+        dst->watched_pages  = 0;
+        dst->private_pages  = 0;
+        dst->writable_pages = 0;
+        for (u8 page = 0; page < PAGE_COUNT; page++) {
+                if (src->private_pages & (1u << page)) {
+                        make_page_private(dst, page);
+                }
+        }
+}
+
+#endif
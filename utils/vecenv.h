@@ -0,0 +1,73 @@
+#ifndef VECENV_H
+#define VECENV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// C ABI of libchip8env, a batch of chip8 machines stepped together whose
+// displays are written in place into one shared memory block:
+//
+//   [chip8_vecenv_header_t][observations, obs_stride bytes per env][done]
+//
+// A consumer process can shm_open() the same name and read observations
+// without copying. `steps` is bumped after every batched step finished writing.
+
+#define CHIP8_VECENV_API __attribute__((visibility("default")))
+
+#define CHIP8_VECENV_MAGIC   0x45563843u  // "C8VE"
+#define CHIP8_VECENV_VERSION 1
+
+typedef enum {
+        CHIP8_OBS_PACKED = 0,  // 32 rows of uint64_t, MSB is the leftmost pixel
+        CHIP8_OBS_BYTES  = 1,  // 64x32 bytes, 1 = pixel on
+} chip8_obs_format_t;
+
+typedef struct {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t num_envs;
+        uint32_t format;  // chip8_obs_format_t
+        uint32_t width;
+        uint32_t height;
+        uint32_t obs_offset;   // From the start of the mapping
+        uint32_t obs_stride;   // Bytes per env observation
+        uint32_t done_offset;  // One byte per env, 1 once the machine quit
+        uint32_t _reserved;
+        uint64_t steps;
+} chip8_vecenv_header_t;
+
+typedef struct chip8_vecenv   chip8_vecenv_t;
+typedef struct chip8_snapshot chip8_snapshot_t;
+
+// shm_name follows shm_open() rules ("/name"), NULL keeps the mapping private
+// to this process. Returns NULL on failure.
+CHIP8_VECENV_API chip8_vecenv_t* chip8_vecenv_create(
+    const char*        rom_path,
+    uint32_t           num_envs,
+    chip8_obs_format_t format,
+    const char*        shm_name);
+CHIP8_VECENV_API void chip8_vecenv_destroy(chip8_vecenv_t* env);
+
+CHIP8_VECENV_API uint32_t chip8_vecenv_num_envs(const chip8_vecenv_t* env);
+CHIP8_VECENV_API void*    chip8_vecenv_shm(const chip8_vecenv_t* env);
+CHIP8_VECENV_API size_t   chip8_vecenv_shm_size(const chip8_vecenv_t* env);
+
+// keys holds one keypad mask per env (bit N = key N down), NULL leaves the
+// keypads as they are. Every env then runs `frames` 60hz frames.
+CHIP8_VECENV_API void chip8_vecenv_step(chip8_vecenv_t* env,
+                                        const uint16_t* keys,
+                                        uint32_t        frames);
+
+// Resets the envs whose mask byte is non zero (every env when mask is NULL)
+// to snapshot, or to the freshly loaded rom when snapshot is NULL.
+CHIP8_VECENV_API void chip8_vecenv_reset(chip8_vecenv_t*         env,
+                                         const uint8_t*          mask,
+                                         const chip8_snapshot_t* snapshot);
+
+// Captures env `index` so it can later be handed to chip8_vecenv_reset.
+CHIP8_VECENV_API chip8_snapshot_t* chip8_vecenv_snapshot(
+    const chip8_vecenv_t* env,
+    uint32_t              index);
+CHIP8_VECENV_API void chip8_snapshot_free(chip8_snapshot_t* snapshot);
+
+#endif